@@ -57,11 +57,11 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
 		*/
 		//To left ghost
 		if (comm->rank_x>0)
-			MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , 1 , comm->column_type ,
 				comm->rank_x-1 , SEND_LEFT  , MPI_COMM_WORLD);
 		//To right ghost
 		if (comm->rank_x<comm->nb_x-1)
-			MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , comm->height * DIRECTIONS , MPI_DOUBLE , 
+			MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , 1 , comm->column_type , 
 				comm->rank_x+1 , SEND_RIGHT , MPI_COMM_WORLD);
 
 		
@@ -72,14 +72,14 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
 		//From right ghost aka SEND_LEFT
 		if (comm->rank_x<comm->nb_x-1)
 		{
-			MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , 1 , comm->column_type ,
 				comm->rank_x+1 , SEND_LEFT  , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 		}
 			
 		//From left ghost aka SEND_RIGHT
 		if (comm->rank_x>0)
 		{
-			MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , 1 , comm->column_type ,
 				comm->rank_x-1 , SEND_RIGHT , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 		}
 	} else {
@@ -91,14 +91,14 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
 		//From right ghost aka SEND_LEFT
 		if (comm->rank_x<comm->nb_x-1)
 		{
-			MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , 1 , comm->column_type ,
 				comm->rank_x+1 , SEND_LEFT  , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 		}
 			
 		//From left ghost aka SEND_RIGHT
 		if (comm->rank_x>0)
 		{
-			MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , 1 , comm->column_type ,
 				comm->rank_x-1 , SEND_RIGHT , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 		}
 
@@ -107,11 +107,11 @@ void lbm_comm_ghost_exchange_ex2(lbm_comm_t * comm, lbm_mesh_t * mesh)
 		*/
 		//To left ghost
 		if (comm->rank_x>0)
-			MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+			MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , 1 , comm->column_type ,
 				comm->rank_x-1 , SEND_LEFT  , MPI_COMM_WORLD);
 		//To right ghost
 		if (comm->rank_x<comm->nb_x-1)
-			MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , comm->height * DIRECTIONS , MPI_DOUBLE , 
+			MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , 1 , comm->column_type , 
 				comm->rank_x+1 , SEND_RIGHT , MPI_COMM_WORLD);
 
 
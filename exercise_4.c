@@ -42,8 +42,8 @@ void lbm_comm_init_ex4(lbm_comm_t * comm, int total_width, int total_height)
 
 
 	//        calculate the number of tasks along X axis and Y axis.
-	comm->nb_x = comm_size/2; //TODO : assuming comm_size is nonzero divisible by 2
-	comm->nb_y = 2;
+	//        the grid minimizing the ghost cells for the mesh shape
+	lbm_comm_plan_grid(comm_size, total_width, total_height, &comm->nb_x, &comm->nb_y);
 
 	//        calculate the current task position in the splitting
 	comm->rank_x = rank%(comm->nb_x); // we choose horizontal order ie rank_x order
@@ -80,6 +80,9 @@ void lbm_comm_init_ex4(lbm_comm_t * comm, int total_width, int total_height)
 	//OPTIONAL : if you want to avoid allocating temporary copy buffer
 	//           for every step :
 	//comm->buffer_recv_down, comm->buffer_recv_up, comm->buffer_send_down, comm->buffer_send_up
+	//a single line buffer is enough, the vertical messages are blocking.
+	//sized for the full mesh width as the weighted splitting may move the cuts after us
+	comm->buffer_send_up = malloc(sizeof(double) * (total_width + 2) * DIRECTIONS);
 
 	//if debug print comm
 	#ifndef NDEBUG
@@ -91,6 +94,8 @@ void lbm_comm_init_ex4(lbm_comm_t * comm, int total_width, int total_height)
 void lbm_comm_release_ex4(lbm_comm_t * comm)
 {
 	//free allocated ressources
+	free(comm->buffer_send_up);
+	comm->buffer_send_up = NULL;
 }
 
 /****************************************************/
@@ -105,10 +110,8 @@ void copy_line_to_buffer(lbm_comm_t * comm, lbm_mesh_t * mesh, double * temp, in
 	for (size_t i = 0; i < comm->width; i++)
 	{
 		//we fetch the i^th cell ie the i^th x
-		double* pointer = lbm_mesh_get_cell(mesh,i,y);
-
 		for (size_t j = 0; j < DIRECTIONS; j++){
-			temp[i*DIRECTIONS + j] = *(pointer + j);
+			temp[i*DIRECTIONS + j] = *lbm_mesh_get_value(mesh,i,y,j);
 		}
 	}
 }
@@ -119,10 +122,8 @@ void copy_line_from_buffer(lbm_comm_t * comm, lbm_mesh_t * mesh, double * temp,
 	for (size_t i = 0; i < comm->width; i++)
 	{
 		//we fetch the i^th cell ie the i^th x
-		double* pointer = lbm_mesh_get_cell(mesh,i,y);
-
 		for (size_t j = 0; j < DIRECTIONS; j++){
-			*(pointer + j) = temp[i*DIRECTIONS + j];
+			*lbm_mesh_get_value(mesh,i,y,j) = temp[i*DIRECTIONS + j];
 		}
 	}
 }
@@ -164,7 +165,7 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//To left ghost
 	if (comm->rank_x>0)
 	{
-		MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+		MPI_Ssend( lbm_mesh_get_cell(mesh,1            ,0) , 1 , comm->column_type ,
 			get_rank(comm,comm->rank_x-1,comm->rank_y) , SEND_LEFT  , MPI_COMM_WORLD);
 	}
 
@@ -174,7 +175,7 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//From right ghost aka SEND_LEFT
 	if (comm->rank_x<comm->nb_x-1)
 	{
-		MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+		MPI_Recv( lbm_mesh_get_cell(mesh,comm->width-1,0) , 1 , comm->column_type ,
 			get_rank(comm,comm->rank_x+1,comm->rank_y) , SEND_LEFT  , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 	}
 
@@ -185,7 +186,7 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//To right ghost
 	if (comm->rank_x<comm->nb_x-1)
 	{
-		MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , comm->height * DIRECTIONS , MPI_DOUBLE , 
+		MPI_Ssend( lbm_mesh_get_cell(mesh,comm->width-2,0) , 1 , comm->column_type , 
 			get_rank(comm,comm->rank_x+1,comm->rank_y) , SEND_RIGHT , MPI_COMM_WORLD);
 	}
 
@@ -196,14 +197,14 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 	//From left ghost aka SEND_RIGHT
 	if (comm->rank_x>0)
 	{
-		MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , comm->height * DIRECTIONS , MPI_DOUBLE ,
+		MPI_Recv( lbm_mesh_get_cell(mesh,0            ,0) , 1 , comm->column_type ,
 			get_rank(comm,comm->rank_x-1,comm->rank_y) , SEND_RIGHT , MPI_COMM_WORLD , MPI_STATUS_IGNORE);
 	}
 
 
 
-	// TODO : allocate memory and horizontal cache ??
-	double* temp = malloc(sizeof(double) * comm->width * DIRECTIONS *2);
+	//line buffer allocated once in lbm_comm_init_ex4()
+	double* temp = comm->buffer_send_up;
 
 
 	/*********** VERTICAL ***********/
@@ -258,7 +259,4 @@ void lbm_comm_ghost_exchange_ex4(lbm_comm_t * comm, lbm_mesh_t * mesh)
 		
 		copy_line_from_buffer(comm , mesh , temp , 0);
 	}
-
-
-	free(temp);
 }
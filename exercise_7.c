@@ -0,0 +1,94 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+//////////////////////////////////////////////////////
+//
+// Goal: Implement 2D grid communication scheme with
+//       8 neighbors using an MPI cartesian topology
+//       and neighborhood collectives.
+//
+// SUMMARY:
+//     - 2D splitting along X and Y
+//     - 8 neighbors communications
+//     - MPI types for non contiguous cells
+// NEW:
+//     - >>> MPI_Cart_create with rank reordering <<<
+//     - >>> MPI_Neighbor_alltoallw <<<
+//
+//////////////////////////////////////////////////////
+
+/****************************************************/
+#include "src/lbm_struct.h"
+#include "src/exercises.h"
+#define XID 1
+#define YID 0
+
+/****************************************************/
+void lbm_comm_init_ex7(lbm_comm_t * comm, int total_width, int total_height)
+{
+	//vars
+	int rank;
+	int comm_size;
+	int dims[2];
+	int periods[2] = {0, 0};
+	int coords[2];
+
+	//get infos
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+
+	//same splitting than ex4
+	lbm_comm_plan_grid( comm_size, total_width, total_height, &comm->nb_x, &comm->nb_y );
+
+	//let MPI renumber the ranks to map the grid on the hardware, ranks are
+	//numbered line by line (Y is the slowest dimension) like in the other exercises
+	dims[XID] = comm->nb_x;
+	dims[YID] = comm->nb_y;
+	MPI_Cart_create( MPI_COMM_WORLD, 2, dims, periods, 1, &comm->communicator );
+
+	//position in the grid
+	MPI_Comm_rank( comm->communicator, &rank );
+	MPI_Cart_coords( comm->communicator, rank, 2, coords );
+	comm->rank_x = coords[XID];
+	comm->rank_y = coords[YID];
+
+	//local sub-domain with ghost cells, the last ones get the remaining cells
+	comm->width  = total_width / comm->nb_x + 2;
+	comm->height = total_height / comm->nb_y + 2;
+	if (comm->rank_x == comm->nb_x - 1)
+		comm->width  += total_width % comm->nb_x;
+	if (comm->rank_y == comm->nb_y - 1)
+		comm->height += total_height % comm->nb_y;
+
+	//absolute position
+	comm->x = total_width / comm->nb_x * comm->rank_x;
+	comm->y = total_height / comm->nb_y * comm->rank_y;
+
+	//graph of the 8 neighboors for the collective exchange
+	lbm_comm_neighbour_graph_init( comm );
+
+	//if debug print comm
+	#ifndef NDEBUG
+	lbm_comm_print( comm );
+	#endif
+}
+
+/****************************************************/
+void lbm_comm_release_ex7(lbm_comm_t * comm)
+{
+	lbm_comm_neighbour_graph_release( comm );
+	MPI_Comm_free( &comm->communicator );
+	comm->communicator = MPI_COMM_WORLD;
+}
+
+/****************************************************/
+void lbm_comm_ghost_exchange_ex7(lbm_comm_t * comm, lbm_mesh_t * mesh)
+{
+	//all the sides and corners in a single collective, the corners come from
+	//the diagonal neighboors so there is no ordering between the directions
+	lbm_comm_ghost_exchange_neighbour( comm, mesh );
+}
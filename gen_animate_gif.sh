@@ -130,6 +130,13 @@ run_parallel()
 	rm -rf ${TMPDIR}
 }
 
+# native rendering by display, set RENDERER=gnuplot to get the axes & the color box
+if [ "${RENDERER}" != "gnuplot" ]; then
+	./display --gif ${INPUT_FILE} ${OUTPUT_FILE} || fail "Fail to render ${INPUT_FILE} !"
+	echo "Done"
+	exit 0
+fi
+
 # check
 which gnuplot > /dev/null || fail "ERROR: You need GNUPLOT to make rendering !"
 which parallel > /dev/null && HAVE_PARALLEL='yes' || HAVE_PARALLEL='no'
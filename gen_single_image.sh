@@ -29,7 +29,11 @@ gen_gnuplot_command()
 	echo "splot \"< ./display --gnuplot ${INPUT_FILE} ${IMG_ID} \" u 1:2:4"
 }
 
-#call if
+#call if, native rendering by display unless RENDERER=gnuplot
+if [ "${RENDERER}" != "gnuplot" ]; then
+	./display --png ${INPUT_FILE} ${IMG_ID} ${OUTPUT_FILE}
+	exit $?
+fi
 
 gen_gnuplot_command | gnuplot
 
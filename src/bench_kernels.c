@@ -0,0 +1,514 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifdef __APPLE__
+	//nothing to define, do not have argp.h
+#else
+	#define HAVE_ARGP
+#endif
+
+/********************  HEADERS  *********************/
+#ifdef HAVE_ARGP
+	#include <argp.h>
+#else
+	#include <unistd.h>
+	#include <getopt.h>
+#endif
+#include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include "lbm_config.h"
+#include "lbm_struct.h"
+#include "lbm_phys.h"
+#include "lbm_init.h"
+#include "lbm_comm.h"
+#include "lbm_save.h"
+#include "lbm_simd.h"
+
+/****************************************************/
+/** Approximate number of floating point operations of the D2Q9 BGK collision of one cell. **/
+#define LBM_BENCH_COLLISION_FLOPS 128.0
+/** Approximate number of floating point operations to compute the density and velocity norm of one cell. **/
+#define LBM_BENCH_SAVE_FLOPS 32.0
+/** Minimal duration of a trial (seconds), the number of repetitions is calibrated to reach it. **/
+#define LBM_BENCH_MIN_TRIAL_TIME 0.01
+/** Maximum number of trials. **/
+#define LBM_BENCH_MAX_TRIALS 64
+
+/****************************************************/
+/**
+ * State shared by the kernels for one mesh size and one layout.
+**/
+typedef struct lbm_bench_ctx_s
+{
+	lbm_comm_t comm;
+	lbm_mesh_t mesh;
+	lbm_mesh_t temp;
+	lbm_mesh_type_t mesh_type;
+	lbm_file_mesh_t file_mesh;
+	/** Ratio of cells which are not CELL_FUILD. **/
+	double special_ratio;
+} lbm_bench_ctx_t;
+
+/****************************************************/
+/**
+ * Description of a benchmarked kernel.
+**/
+typedef struct lbm_bench_kernel_s
+{
+	/** Name used in the reports and by -k/--kernel. **/
+	const char * name;
+	/** If true, run it with each SIMD collision kernel. **/
+	int use_simd;
+	/** Floating point operations per cell. **/
+	double flops;
+	/** Function computing the memory traffic per cell. **/
+	double (*bytes)(const lbm_bench_ctx_t * ctx);
+	/** Run the kernel once over the mesh. **/
+	void (*run)(lbm_bench_ctx_t * ctx);
+} lbm_bench_kernel_t;
+
+/****************************************************/
+// To parse arguments.
+const char *argp_program_version = "bench_kernels 1.0";
+const char *argp_program_bug_address = "<sebastien.valat@univ-grenoble-alpes.fr>";
+static char doc[] = "Micro-benchmark of the LBM kernels from L1 resident to DRAM resident meshes.";
+#ifdef HAVE_ARGP
+	static char args_doc[] = "";
+	static struct argp_option options[] = {
+		{"trials",   't', "COUNT", 0, "Number of measured trials for each point (default 5)." },
+		{"min-size", 'm', "SIDE",  0, "Smallest mesh side (default 8)." },
+		{"max-size", 'M', "SIDE",  0, "Largest mesh side, doubled from min-size (default 1024)." },
+		{"kernel",   'k', "NAME",  0, "Only run the given kernel." },
+		{"output",   'o', "FILE",  0, "Also write the results in CSV into FILE." },
+		{ 0 }
+	};
+#else
+	static struct option long_options[] = {
+			{ "trials",     required_argument,      NULL,           't' },
+			{ "min-size",   required_argument,      NULL,           'm' },
+			{ "max-size",   required_argument,      NULL,           'M' },
+			{ "kernel",     required_argument,      NULL,           'k' },
+			{ "output",     required_argument,      NULL,           'o' },
+			{ "help",       no_argument,            NULL,           '?' },
+			{ NULL,         0,                      NULL,           0 }
+	};
+	static const char * short_options = "[-t COUNT] [-m SIDE] [-M SIDE] [-k NAME] [-o FILE]";
+	static const char * help_message =
+		"-t/--trials   {COUNT}   Number of measured trials for each point (default 5).\n"
+		"-m/--min-size {SIDE}    Smallest mesh side (default 8).\n"
+		"-M/--max-size {SIDE}    Largest mesh side, doubled from min-size (default 1024).\n"
+		"-k/--kernel   {NAME}    Only run the given kernel.\n"
+		"-o/--output   {FILE}    Also write the results in CSV into FILE.\n";
+#endif
+
+/****************************************************/
+/* Used by main to communicate with parse_opt. */
+struct arguments
+{
+	int trials;
+	int min_size;
+	int max_size;
+	const char * kernel;
+	const char * output;
+};
+
+/****************************************************/
+/* Parse a single option. */
+#ifdef HAVE_ARGP
+static error_t parse_opt (int key, char *arg, struct argp_state *state)
+{
+	//get args
+	struct arguments *arguments = state->input;
+
+	switch (key)
+	{
+		case 't':
+			arguments->trials = atoi(arg);
+			break;
+		case 'm':
+			arguments->min_size = atoi(arg);
+			break;
+		case 'M':
+			arguments->max_size = atoi(arg);
+			break;
+		case 'k':
+			arguments->kernel = arg;
+			break;
+		case 'o':
+			arguments->output = arg;
+			break;
+		case ARGP_KEY_ARG:
+			argp_usage (state);
+			break;
+		case ARGP_KEY_END:
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+#endif
+
+/****************************************************/
+/* Our argp parser. */
+#ifdef HAVE_ARGP
+	static struct argp argp = { options, parse_opt, args_doc, doc };
+#endif
+
+/****************************************************/
+#ifdef HAVE_ARGP
+void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
+{
+	argp_parse (&argp, argc, argv, 0, 0, arguments);
+}
+#else //HAVE_ARGP
+void print_help_message(char ** argv)
+{
+	printf("%s\n", argp_program_version);
+	printf("%s\n", argp_program_bug_address);
+	printf("%s\n", doc);
+	printf("\n");
+	printf("%s %s\n", argv[0], short_options);
+	printf("\nOptions:\n");
+	printf("%s", help_message);
+}
+
+void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
+{
+	int c;
+	while ( (c = getopt_long(argc, argv, "t:m:M:k:o:", long_options, NULL)) != -1) {
+		switch(c) {
+			case 't':
+				arguments->trials = atoi(optarg);
+				break;
+			case 'm':
+				arguments->min_size = atoi(optarg);
+				break;
+			case 'M':
+				arguments->max_size = atoi(optarg);
+				break;
+			case 'k':
+				arguments->kernel = strdup(optarg);
+				break;
+			case 'o':
+				arguments->output = strdup(optarg);
+				break;
+			case '?':
+				print_help_message(argv);
+				exit(0);
+				break;
+			default:
+				print_help_message(argv);
+				exit(1);
+				break;
+		}
+	}
+}
+#endif //HAVE_ARGP
+
+/****************************************************/
+static void lbm_bench_run_collision(lbm_bench_ctx_t * ctx)
+{
+	lbm_phys_collision(&ctx->temp, &ctx->mesh);
+}
+
+/****************************************************/
+static void lbm_bench_run_propagation(lbm_bench_ctx_t * ctx)
+{
+	lbm_phys_propagation(&ctx->mesh, &ctx->temp);
+}
+
+/****************************************************/
+static void lbm_bench_run_special_cells(lbm_bench_ctx_t * ctx)
+{
+	lbm_phys_special_cells(&ctx->mesh, &ctx->mesh_type, &ctx->comm);
+}
+
+/****************************************************/
+static void lbm_bench_run_save_fill(lbm_bench_ctx_t * ctx)
+{
+	lbm_save_fill_mesh(&ctx->file_mesh, &ctx->mesh, &ctx->mesh_type);
+}
+
+/****************************************************/
+static void lbm_bench_run_collide_stream(lbm_bench_ctx_t * ctx)
+{
+	lbm_phys_collide_and_stream(&ctx->temp, &ctx->mesh, &ctx->mesh_type, &ctx->comm);
+	lbm_mesh_swap(&ctx->mesh, &ctx->temp);
+}
+
+/****************************************************/
+static void lbm_bench_run_aa(lbm_bench_ctx_t * ctx)
+{
+	if (ctx->mesh.aa_swapped)
+		lbm_phys_aa_odd_step(&ctx->mesh, &ctx->mesh_type, &ctx->comm);
+	else
+		lbm_phys_aa_even_step(&ctx->mesh, &ctx->mesh_type, &ctx->comm);
+}
+
+/****************************************************/
+/** One read and one write of all the directions. **/
+static double lbm_bench_bytes_one_pass(const lbm_bench_ctx_t * ctx)
+{
+	return 2.0 * DIRECTIONS * sizeof(double);
+}
+
+/****************************************************/
+/** One pass plus the cell types. **/
+static double lbm_bench_bytes_one_pass_with_types(const lbm_bench_ctx_t * ctx)
+{
+	return 2.0 * DIRECTIONS * sizeof(double) + sizeof(lbm_cell_type_t);
+}
+
+/****************************************************/
+/** Read the types, only the special cells are loaded and stored. **/
+static double lbm_bench_bytes_special_cells(const lbm_bench_ctx_t * ctx)
+{
+	return sizeof(lbm_cell_type_t) + ctx->special_ratio * 2.0 * DIRECTIONS * sizeof(double);
+}
+
+/****************************************************/
+/** Read the cells and types, write the density and velocity norm. **/
+static double lbm_bench_bytes_save_fill(const lbm_bench_ctx_t * ctx)
+{
+	return DIRECTIONS * sizeof(double) + sizeof(lbm_cell_type_t) + sizeof(lbm_file_entry_t);
+}
+
+/****************************************************/
+/** List of the kernels to benchmark. **/
+static const lbm_bench_kernel_t gbl_kernels[] = {
+	{"collision",      1, LBM_BENCH_COLLISION_FLOPS, lbm_bench_bytes_one_pass,            lbm_bench_run_collision},
+	{"propagation",    0, 0.0,                       lbm_bench_bytes_one_pass,            lbm_bench_run_propagation},
+	{"special_cells",  0, 0.0,                       lbm_bench_bytes_special_cells,       lbm_bench_run_special_cells},
+	{"save_fill",      0, LBM_BENCH_SAVE_FLOPS,      lbm_bench_bytes_save_fill,           lbm_bench_run_save_fill},
+	{"collide_stream", 1, LBM_BENCH_COLLISION_FLOPS, lbm_bench_bytes_one_pass_with_types, lbm_bench_run_collide_stream},
+	{"aa",             1, LBM_BENCH_COLLISION_FLOPS, lbm_bench_bytes_one_pass_with_types, lbm_bench_run_aa},
+};
+
+/****************************************************/
+/**
+ * Setup a sequential domain of side x side cells (ghost cells included) with the same
+ * initial conditions than the simulation.
+**/
+static void lbm_bench_ctx_init(lbm_bench_ctx_t * ctx, int side, lbm_mesh_layout_t layout)
+{
+	//vars
+	int i,j;
+	long special = 0;
+
+	//config of the global problem
+	lbm_config_set_default();
+	MESH_WIDTH = side - 2;
+	MESH_HEIGHT = side - 2;
+	lbm_gbl_config.obstacle_x = (MESH_WIDTH / 5.0 + 1.0);
+	lbm_gbl_config.obstacle_r = (MESH_HEIGHT / 10.0 + 1.0);
+	lbm_gbl_config.obstacle_y = (MESH_HEIGHT / 2.0 + 3.0);
+	lbm_config_drived_parameters();
+	//never opened, only to enable lbm_save_fill_mesh()
+	RESULT_FILENAME = "bench_kernels";
+	MESH_LAYOUT = layout;
+	//also allocate the ring and the column buffers used by the aa and fused kernels
+	STEP_MODE = LBM_STEP_AA;
+
+	//single domain
+	memset(&ctx->comm, 0, sizeof(ctx->comm));
+	ctx->comm.nb_x = 1;
+	ctx->comm.nb_y = 1;
+	ctx->comm.width = side;
+	ctx->comm.height = side;
+
+	//allocate & init
+	lbm_mesh_init(&ctx->mesh, side, side);
+	lbm_mesh_init(&ctx->temp, side, side);
+	lbm_mesh_type_t_init(&ctx->mesh_type, side, side);
+	lbm_save_mesh_init(&ctx->file_mesh, &ctx->comm);
+	lbm_init_mesh_state(&ctx->mesh, &ctx->mesh_type, &ctx->comm);
+	lbm_init_mesh_state(&ctx->temp, &ctx->mesh_type, &ctx->comm);
+
+	//count special cells
+	for ( i = 0 ; i < side ; i++ )
+		for ( j = 0 ; j < side ; j++ )
+			if (*lbm_cell_type_t_get_cell(&ctx->mesh_type, i, j) != CELL_FUILD)
+				special++;
+	ctx->special_ratio = (double)special / ((double)side * side);
+}
+
+/****************************************************/
+static void lbm_bench_ctx_release(lbm_bench_ctx_t * ctx)
+{
+	lbm_mesh_release(&ctx->mesh);
+	lbm_mesh_release(&ctx->temp);
+	lbm_mesh_type_t_release(&ctx->mesh_type);
+	lbm_save_mesh_release(&ctx->file_mesh);
+	RESULT_FILENAME = NULL;
+}
+
+/****************************************************/
+static int lbm_bench_compare_double(const void * a, const void * b)
+{
+	double da = *(const double*)a;
+	double db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+/****************************************************/
+/**
+ * Measure one kernel. The number of repetitions is doubled until a run lasts at least
+ * LBM_BENCH_MIN_TRIAL_TIME (this also warms up the caches), then trials are measured.
+ * @param times Receive the sorted time per cell of each trial (seconds).
+ * @return The number of repetitions of each trial.
+**/
+static long lbm_bench_measure(lbm_bench_ctx_t * ctx, const lbm_bench_kernel_t * kernel, int trials, double * times)
+{
+	//vars
+	long reps = 1;
+	long r;
+	int t;
+	double start, duration;
+	const double cells = (double)ctx->mesh.width * ctx->mesh.height;
+
+	//calibrate
+	while (1)
+	{
+		start = MPI_Wtime();
+		for ( r = 0 ; r < reps ; r++ )
+			kernel->run(ctx);
+		duration = MPI_Wtime() - start;
+		if (duration >= LBM_BENCH_MIN_TRIAL_TIME)
+			break;
+		reps *= 2;
+	}
+
+	//trials
+	for ( t = 0 ; t < trials ; t++ )
+	{
+		start = MPI_Wtime();
+		for ( r = 0 ; r < reps ; r++ )
+			kernel->run(ctx);
+		duration = MPI_Wtime() - start;
+		times[t] = duration / (double)reps / cells;
+	}
+
+	//sort for min/median/max
+	qsort(times, trials, sizeof(double), lbm_bench_compare_double);
+
+	return reps;
+}
+
+/****************************************************/
+int main(int argc, char * argv[])
+{
+	//vars
+	int comm_size;
+	int side;
+	int layout;
+	int isa;
+	size_t k;
+	int threads = 1;
+	double times[LBM_BENCH_MAX_TRIALS];
+	FILE * csv = NULL;
+	lbm_bench_ctx_t ctx;
+
+	//init MPI, the kernels are benchmarked on a single rank
+	MPI_Init( &argc, &argv );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	if (comm_size != 1)
+		fatal("bench_kernels must be run on a single rank !");
+	#ifdef _OPENMP
+		threads = omp_get_max_threads();
+	#endif
+
+	//parse args
+	struct arguments arguments = {
+		.trials = 5,
+		.min_size = 8,
+		.max_size = 1024,
+		.kernel = NULL,
+		.output = NULL,
+	};
+	parse_prgm_arguments(&arguments, argc, argv);
+	if (arguments.trials < 1 || arguments.trials > LBM_BENCH_MAX_TRIALS)
+		fatal("Invalid number of trials !");
+	if (arguments.min_size < 4 || arguments.max_size < arguments.min_size)
+		fatal("Invalid mesh sizes !");
+
+	//csv
+	if (arguments.output != NULL)
+	{
+		csv = fopen(arguments.output, "w");
+		if (csv == NULL)
+		{
+			perror(arguments.output);
+			abort();
+		}
+		fprintf(csv, "kernel,layout,simd,threads,width,height,footprint_bytes,trials,reps,ns_per_cell_min,ns_per_cell_median,ns_per_cell_max,gbs,gflops\n");
+	}
+
+	//header
+	printf("Threads: %d, trials: %d\n", threads, arguments.trials);
+	printf("%-15s %-6s %-7s %6s %12s %9s %9s %9s %8s %8s\n",
+		"kernel", "layout", "simd", "side", "footprint", "ns/c min", "ns/c med", "ns/c max", "GB/s", "GFLOP/s");
+
+	//sweep
+	for ( side = arguments.min_size ; side <= arguments.max_size ; side *= 2 )
+	{
+		for ( layout = LBM_LAYOUT_AOS ; layout <= LBM_LAYOUT_SOA ; layout++ )
+		{
+			lbm_bench_ctx_init(&ctx, side, layout);
+			double footprint = 2.0 * side * side * DIRECTIONS * sizeof(double);
+
+			for ( k = 0 ; k < sizeof(gbl_kernels) / sizeof(gbl_kernels[0]) ; k++ )
+			{
+				const lbm_bench_kernel_t * kernel = &gbl_kernels[k];
+				if (arguments.kernel != NULL && strcmp(arguments.kernel, kernel->name) != 0)
+					continue;
+
+				for ( isa = LBM_SIMD_SCALAR ; isa <= LBM_SIMD_AVX512 ; isa++ )
+				{
+					//only once for the kernels not using the collision kernel
+					if (kernel->use_simd == 0 && isa != LBM_SIMD_SCALAR)
+						break;
+					if (lbm_simd_supported(isa) == 0)
+						continue;
+					lbm_simd_set(isa);
+
+					//measure
+					long reps = lbm_bench_measure(&ctx, kernel, arguments.trials, times);
+					double median = times[arguments.trials / 2];
+					double gbs = kernel->bytes(&ctx) / median / 1e9;
+					double gflops = kernel->flops / median / 1e9;
+					const char * simd = kernel->use_simd ? lbm_config_simd_isa_name(isa) : "-";
+
+					//report
+					printf("%-15s %-6s %-7s %6d %9.0f kB %9.2f %9.2f %9.2f %8.2f %8.2f\n",
+						kernel->name, lbm_config_mesh_layout_name(layout), simd, side, footprint / 1024.0,
+						times[0] * 1e9, median * 1e9, times[arguments.trials - 1] * 1e9, gbs, gflops);
+					if (csv != NULL)
+						fprintf(csv, "%s,%s,%s,%d,%d,%d,%.0f,%d,%ld,%g,%g,%g,%g,%g\n",
+							kernel->name, lbm_config_mesh_layout_name(layout), simd, threads, side, side, footprint,
+							arguments.trials, reps, times[0] * 1e9, median * 1e9, times[arguments.trials - 1] * 1e9, gbs, gflops);
+				}
+			}
+
+			lbm_bench_ctx_release(&ctx);
+		}
+	}
+
+	//close
+	if (csv != NULL)
+		fclose(csv);
+	MPI_Finalize();
+	return EXIT_SUCCESS;
+}
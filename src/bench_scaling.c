@@ -0,0 +1,598 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifdef __APPLE__
+	//nothing to define, do not have argp.h
+#else
+	#define HAVE_ARGP
+#endif
+
+/********************  HEADERS  *********************/
+#ifdef HAVE_ARGP
+	#include <argp.h>
+#else
+	#include <unistd.h>
+	#include <getopt.h>
+#endif
+#include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lbm_config.h"
+#include "lbm_struct.h"
+#include "lbm_phys.h"
+#include "lbm_init.h"
+#include "lbm_comm.h"
+#include "lbm_simd.h"
+#include "lbm_timers.h"
+#include "exercises.h"
+
+/****************************************************/
+/** Maximum number of exercises in the -e list. **/
+#define LBM_SCALING_MAX_EXERCISES 16
+/** Header of the CSV file, also used to detect a new file. **/
+#define LBM_SCALING_CSV_HEADER "mode,exercise,step,layout,simd,exchange,threads,ranks,width,height,warmup,iterations,time,exchange_time,mlups,speedup,efficiency"
+
+/****************************************************/
+/**
+ * One measurement, stored as a line of the CSV file.
+**/
+typedef struct lbm_scaling_record_s
+{
+	char mode[16];
+	int exercise;
+	char step[16];
+	char layout[16];
+	char simd[16];
+	char exchange[16];
+	int threads;
+	int ranks;
+	int width;
+	int height;
+	int warmup;
+	int iterations;
+	/** Duration of the measured iterations (max over the ranks). **/
+	double time;
+	/** Time spent in the ghost cells exchange (max over the ranks). **/
+	double exchange_time;
+	double mlups;
+	/** Compared to the run with the smallest number of ranks of the same serie. **/
+	double speedup;
+	double efficiency;
+} lbm_scaling_record_t;
+
+/****************************************************/
+// To parse arguments.
+const char *argp_program_version = "bench_scaling 1.0";
+const char *argp_program_bug_address = "<sebastien.valat@univ-grenoble-alpes.fr>";
+static char doc[] = "Strong & weak scaling harness timing the time loop of each exercise, without the launch overhead.\n"
+                    "Run it with mpirun for each number of ranks, the results are accumulated in the CSV file.";
+#ifdef HAVE_ARGP
+	static char args_doc[] = "";
+	static struct argp_option options[] = {
+		{"config",     'c', "FILE",  0, "Input config file to use (default config.txt)." },
+		{"exercises",  'e', "LIST",  0, "Comma separated list of exercises to run (default 1,2,3,4)." },
+		{"mode",       'm', "MODE",  0, "Scaling mode: 'strong' keeps the mesh size, 'weak' scales it by the number of ranks (default strong)." },
+		{"scaling",    's', "FACTOR",0, "Base weak scaling factor applied before the per rank scaling (default 1)." },
+		{"warmup",     'w', "COUNT", 0, "Number of untimed iterations (default 10)." },
+		{"iterations", 'n', "COUNT", 0, "Number of timed iterations (default 100)." },
+		{"output",     'o', "FILE",  0, "CSV file accumulating the results (default scale.csv)." },
+		{"json",       'j', "FILE",  0, "Also write the efficiency table of all the runs in JSON into FILE." },
+		{ 0 }
+	};
+#else
+	static struct option long_options[] = {
+			{ "config",     required_argument,      NULL,           'c' },
+			{ "exercises",  required_argument,      NULL,           'e' },
+			{ "mode",       required_argument,      NULL,           'm' },
+			{ "scaling",    required_argument,      NULL,           's' },
+			{ "warmup",     required_argument,      NULL,           'w' },
+			{ "iterations", required_argument,      NULL,           'n' },
+			{ "output",     required_argument,      NULL,           'o' },
+			{ "json",       required_argument,      NULL,           'j' },
+			{ "help",       no_argument,            NULL,           '?' },
+			{ NULL,         0,                      NULL,           0 }
+	};
+	static const char * short_options = "[-c CONFIG] [-e LIST] [-m MODE] [-s FACTOR] [-w COUNT] [-n COUNT] [-o FILE] [-j FILE]";
+	static const char * help_message =
+		"-c/--config     {FILE}    Input config file to use (default config.txt).\n"
+		"-e/--exercises  {LIST}    Comma separated list of exercises to run (default 1,2,3,4).\n"
+		"-m/--mode       {MODE}    Scaling mode: 'strong' keeps the mesh size, 'weak' scales it by the number of ranks (default strong).\n"
+		"-s/--scaling    {FACTOR}  Base weak scaling factor applied before the per rank scaling (default 1).\n"
+		"-w/--warmup     {COUNT}   Number of untimed iterations (default 10).\n"
+		"-n/--iterations {COUNT}   Number of timed iterations (default 100).\n"
+		"-o/--output     {FILE}    CSV file accumulating the results (default scale.csv).\n"
+		"-j/--json       {FILE}    Also write the efficiency table of all the runs in JSON into FILE.\n";
+#endif
+
+/****************************************************/
+/* Used by main to communicate with parse_opt. */
+struct arguments
+{
+	const char * config_file;
+	const char * exercises;
+	const char * mode;
+	int scaling;
+	int warmup;
+	int iterations;
+	const char * output;
+	const char * json;
+};
+
+/****************************************************/
+/* Parse a single option. */
+#ifdef HAVE_ARGP
+static error_t parse_opt (int key, char *arg, struct argp_state *state)
+{
+	//get args
+	struct arguments *arguments = state->input;
+
+	switch (key)
+	{
+		case 'c':
+			arguments->config_file = arg;
+			break;
+		case 'e':
+			arguments->exercises = arg;
+			break;
+		case 'm':
+			arguments->mode = arg;
+			break;
+		case 's':
+			arguments->scaling = atoi(arg);
+			break;
+		case 'w':
+			arguments->warmup = atoi(arg);
+			break;
+		case 'n':
+			arguments->iterations = atoi(arg);
+			break;
+		case 'o':
+			arguments->output = arg;
+			break;
+		case 'j':
+			arguments->json = arg;
+			break;
+		case ARGP_KEY_ARG:
+			argp_usage (state);
+			break;
+		case ARGP_KEY_END:
+			break;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+#endif
+
+/****************************************************/
+/* Our argp parser. */
+#ifdef HAVE_ARGP
+	static struct argp argp = { options, parse_opt, args_doc, doc };
+#endif
+
+/****************************************************/
+#ifdef HAVE_ARGP
+void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
+{
+	argp_parse (&argp, argc, argv, 0, 0, arguments);
+}
+#else //HAVE_ARGP
+void print_help_message(char ** argv)
+{
+	printf("%s\n", argp_program_version);
+	printf("%s\n", argp_program_bug_address);
+	printf("%s\n", doc);
+	printf("\n");
+	printf("%s %s\n", argv[0], short_options);
+	printf("\nOptions:\n");
+	printf("%s", help_message);
+}
+
+void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
+{
+	int c;
+	while ( (c = getopt_long(argc, argv, "c:e:m:s:w:n:o:j:", long_options, NULL)) != -1) {
+		switch(c) {
+			case 'c':
+				arguments->config_file = strdup(optarg);
+				break;
+			case 'e':
+				arguments->exercises = strdup(optarg);
+				break;
+			case 'm':
+				arguments->mode = strdup(optarg);
+				break;
+			case 's':
+				arguments->scaling = atoi(optarg);
+				break;
+			case 'w':
+				arguments->warmup = atoi(optarg);
+				break;
+			case 'n':
+				arguments->iterations = atoi(optarg);
+				break;
+			case 'o':
+				arguments->output = strdup(optarg);
+				break;
+			case 'j':
+				arguments->json = strdup(optarg);
+				break;
+			case '?':
+				print_help_message(argv);
+				exit(0);
+				break;
+			default:
+				print_help_message(argv);
+				exit(1);
+				break;
+		}
+	}
+}
+#endif //HAVE_ARGP
+
+/****************************************************/
+/**
+ * Parse the comma separated list of exercises.
+ * @return The number of exercises placed in ids.
+**/
+static int lbm_scaling_parse_exercises(const char * list, int * ids)
+{
+	int count = 0;
+	const char * cur = list;
+	while (*cur != '\0')
+	{
+		if (count >= LBM_SCALING_MAX_EXERCISES)
+			fatal("Too many exercises in the list !");
+		ids[count++] = atoi(cur);
+		cur = strchr(cur, ',');
+		if (cur == NULL)
+			break;
+		cur++;
+	}
+	return count;
+}
+
+/****************************************************/
+/**
+ * Some exercises impose constraints on the number of ranks.
+**/
+static int lbm_scaling_exercise_supported(int exercise, int comm_size)
+{
+	switch (exercise)
+	{
+		case 0:
+			//sequential
+			return comm_size == 1;
+		default:
+			return 1;
+	}
+}
+
+/****************************************************/
+/**
+ * Run the time loop of an exercise on all the ranks, the warmup iterations are not
+ * measured. Nothing is written to the disk.
+ * @param exchange_time Receive the max time spent in the ghost exchange.
+ * @return The max duration of the measured iterations over the ranks.
+**/
+static double lbm_scaling_run_exercise(int exercise, int warmup, int iterations, double * exchange_time)
+{
+	//vars
+	lbm_mesh_t mesh;
+	lbm_mesh_t temp = { .cells = NULL, .aa_halo = NULL };
+	lbm_mesh_type_t mesh_type;
+	lbm_comm_t comm;
+	double start, time, local_exchange;
+	int i;
+
+	//init structures
+	lbm_ex_select(exercise);
+	lbm_comm_init_ex_select( &comm, MESH_WIDTH, MESH_HEIGHT);
+	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
+	if (STEP_MODE != LBM_STEP_AA)
+		lbm_mesh_init( &temp, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
+	lbm_mesh_type_t_init( &mesh_type, lbm_comm_width( &comm ), lbm_comm_height( &comm ));
+	lbm_init_mesh_state( &mesh, &mesh_type, &comm);
+	if (STEP_MODE != LBM_STEP_AA)
+		lbm_init_mesh_state( &temp, &mesh_type, &comm);
+
+	//warmup
+	for ( i = 0 ; i < warmup ; i++ )
+		lbm_do_step_ex_select(&comm, &mesh_type, &mesh, &temp );
+
+	//measure
+	MPI_Barrier(MPI_COMM_WORLD);
+	memset(lbm_gbl_timers, 0, sizeof(lbm_gbl_timers));
+	start = MPI_Wtime();
+	for ( i = 0 ; i < iterations ; i++ )
+		lbm_do_step_ex_select(&comm, &mesh_type, &mesh, &temp );
+	time = MPI_Wtime() - start;
+
+	//reduce
+	local_exchange = lbm_gbl_timers[LBM_TIMER_EXCHANGE];
+	MPI_Allreduce(MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	MPI_Allreduce(&local_exchange, exchange_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+	//free memory
+	lbm_comm_release_ex_select( &comm );
+	lbm_mesh_release( &mesh );
+	lbm_mesh_release( &temp );
+	lbm_mesh_type_t_release( &mesh_type );
+
+	return time;
+}
+
+/****************************************************/
+/**
+ * Load the records already stored in the CSV file.
+ * @return The number of records, the array need to be freed by the caller.
+**/
+static int lbm_scaling_load_records(const char * filename, lbm_scaling_record_t ** records)
+{
+	//vars
+	char buffer[1024];
+	int count = 0;
+	int capacity = 0;
+	lbm_scaling_record_t record;
+	FILE * fp;
+
+	//init
+	*records = NULL;
+
+	//new file
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return 0;
+
+	//loop on lines
+	while (fgets(buffer, sizeof(buffer), fp) != NULL)
+	{
+		if (strncmp(buffer, "mode,", 5) == 0)
+			continue;
+		if (sscanf(buffer, "%15[^,],%d,%15[^,],%15[^,],%15[^,],%15[^,],%d,%d,%d,%d,%d,%d,%lf,%lf,%lf,%lf,%lf",
+		           record.mode, &record.exercise, record.step, record.layout, record.simd, record.exchange,
+		           &record.threads, &record.ranks, &record.width, &record.height, &record.warmup, &record.iterations,
+		           &record.time, &record.exchange_time, &record.mlups, &record.speedup, &record.efficiency) != 17)
+		{
+			warning("Ignore invalid line in scaling CSV file !");
+			continue;
+		}
+		if (count == capacity)
+		{
+			capacity = (capacity == 0) ? 32 : capacity * 2;
+			*records = realloc(*records, capacity * sizeof(lbm_scaling_record_t));
+		}
+		(*records)[count++] = record;
+	}
+
+	//close
+	fclose(fp);
+	return count;
+}
+
+/****************************************************/
+/**
+ * Check if two records belong to the same scaling serie (everything except the
+ * number of ranks and the induced mesh size).
+**/
+static int lbm_scaling_same_serie(const lbm_scaling_record_t * a, const lbm_scaling_record_t * b)
+{
+	return strcmp(a->mode, b->mode) == 0
+		&& a->exercise == b->exercise
+		&& strcmp(a->step, b->step) == 0
+		&& strcmp(a->layout, b->layout) == 0
+		&& strcmp(a->simd, b->simd) == 0
+		&& strcmp(a->exchange, b->exchange) == 0
+		&& a->threads == b->threads;
+}
+
+/****************************************************/
+/**
+ * Compute the speedup and efficiency of a record compared to the run of the same serie
+ * with the smallest number of ranks (most of the time 1).
+ * In strong scaling : speedup = T_ref * P_ref / T, efficiency = speedup / P.
+ * In weak scaling : efficiency = T_ref / T, speedup = efficiency * P / P_ref.
+**/
+static void lbm_scaling_compute_efficiency(lbm_scaling_record_t * record, const lbm_scaling_record_t * records, int count)
+{
+	//vars
+	const lbm_scaling_record_t * ref = record;
+	int i;
+
+	//search reference
+	for ( i = 0 ; i < count ; i++ )
+		if (lbm_scaling_same_serie(&records[i], record) && records[i].ranks < ref->ranks)
+			ref = &records[i];
+
+	//compute
+	if (strcmp(record->mode, "weak") == 0) {
+		record->efficiency = ref->time / record->time;
+		record->speedup = record->efficiency * record->ranks / ref->ranks;
+	} else {
+		record->speedup = ref->time * ref->ranks / record->time;
+		record->efficiency = record->speedup / record->ranks;
+	}
+}
+
+/****************************************************/
+static void lbm_scaling_write_json(const char * filename, const lbm_scaling_record_t * records, int count)
+{
+	//vars
+	FILE * fp;
+	int i;
+
+	//open
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+	{
+		perror(filename);
+		return;
+	}
+
+	//write
+	fprintf(fp, "[\n");
+	for ( i = 0 ; i < count ; i++ )
+	{
+		const lbm_scaling_record_t * r = &records[i];
+		fprintf(fp, "\t{ \"mode\": \"%s\", \"exercise\": %d, \"step\": \"%s\", \"layout\": \"%s\", \"simd\": \"%s\", \"exchange\": \"%s\", \"threads\": %d, "
+		            "\"ranks\": %d, \"width\": %d, \"height\": %d, \"warmup\": %d, \"iterations\": %d, "
+		            "\"time\": %.9g, \"exchange_time\": %.9g, \"mlups\": %.9g, \"speedup\": %.9g, \"efficiency\": %.9g }%s\n",
+		        r->mode, r->exercise, r->step, r->layout, r->simd, r->exchange, r->threads,
+		        r->ranks, r->width, r->height, r->warmup, r->iterations,
+		        r->time, r->exchange_time, r->mlups, r->speedup, r->efficiency, (i < count - 1) ? "," : "");
+	}
+	fprintf(fp, "]\n");
+
+	//close
+	fclose(fp);
+}
+
+/****************************************************/
+int main(int argc, char * argv[])
+{
+	//vars
+	int rank, comm_size, thread_level;
+	int threads = 1;
+	int exercises[LBM_SCALING_MAX_EXERCISES];
+	int nb_exercises, e, i;
+	int factor;
+	lbm_scaling_record_t * records = NULL;
+	int count = 0;
+	FILE * fp;
+
+	//init MPI
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_level );
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	#ifdef _OPENMP
+		threads = omp_get_max_threads();
+	#endif
+
+	//parse args
+	struct arguments arguments = {
+		.config_file = "config.txt",
+		.exercises = "1,2,3,4",
+		.mode = "strong",
+		.scaling = 1,
+		.warmup = 10,
+		.iterations = 100,
+		.output = "scale.csv",
+		.json = NULL,
+	};
+	parse_prgm_arguments(&arguments, argc, argv);
+	nb_exercises = lbm_scaling_parse_exercises(arguments.exercises, exercises);
+	if (strcmp(arguments.mode, "strong") != 0 && strcmp(arguments.mode, "weak") != 0)
+		fatal("Invalid scaling mode, should be 'strong' or 'weak' !");
+	if (arguments.warmup < 0 || arguments.iterations < 1)
+		fatal("Invalid number of iterations !");
+
+	//load config, results are never written
+	lbm_config_init(arguments.config_file);
+	free((void*)RESULT_FILENAME);
+	RESULT_FILENAME = NULL;
+
+	//weak scaling keep the same amount of cells per rank
+	factor = arguments.scaling;
+	if (strcmp(arguments.mode, "weak") == 0)
+		factor *= comm_size;
+	lbm_config_apply_scaling(factor, comm_size);
+
+	//select kernel
+	lbm_simd_select(SIMD_ISA);
+	#ifdef _OPENMP
+		if (THREADS > 0)
+			omp_set_num_threads(THREADS);
+		threads = omp_get_max_threads();
+	#endif
+
+	//previous results
+	if (rank == RANK_MASTER)
+		count = lbm_scaling_load_records(arguments.output, &records);
+
+	//run
+	for ( e = 0 ; e < nb_exercises ; e++ )
+	{
+		//check
+		if (lbm_scaling_exercise_supported(exercises[e], comm_size) == 0)
+		{
+			if (rank == RANK_MASTER)
+				printf("Skip exercise %d, not supported with %d ranks\n", exercises[e], comm_size);
+			continue;
+		}
+
+		//measure
+		lbm_scaling_record_t record;
+		record.time = lbm_scaling_run_exercise(exercises[e], arguments.warmup, arguments.iterations, &record.exchange_time);
+		if (rank != RANK_MASTER)
+			continue;
+
+		//fill
+		strncpy(record.mode, arguments.mode, sizeof(record.mode) - 1);
+		record.mode[sizeof(record.mode) - 1] = '\0';
+		record.exercise = exercises[e];
+		strcpy(record.step, lbm_config_step_mode_name(STEP_MODE));
+		strcpy(record.layout, lbm_config_mesh_layout_name(MESH_LAYOUT));
+		strcpy(record.simd, lbm_config_simd_isa_name(lbm_simd_selected()));
+		strcpy(record.exchange, lbm_config_exchange_mode_name(EXCHANGE_MODE));
+		record.threads = threads;
+		record.ranks = comm_size;
+		record.width = MESH_WIDTH;
+		record.height = MESH_HEIGHT;
+		record.warmup = arguments.warmup;
+		record.iterations = arguments.iterations;
+		record.mlups = (double)MESH_WIDTH * (double)MESH_HEIGHT * (double)arguments.iterations / record.time / 1e6;
+		lbm_scaling_compute_efficiency(&record, records, count);
+
+		//append
+		records = realloc(records, (count + 1) * sizeof(lbm_scaling_record_t));
+		records[count++] = record;
+		fp = fopen(arguments.output, "a");
+		if (fp == NULL)
+		{
+			perror(arguments.output);
+			abort();
+		}
+		fseek(fp, 0, SEEK_END);
+		if (ftell(fp) == 0)
+			fprintf(fp, "%s\n", LBM_SCALING_CSV_HEADER);
+		fprintf(fp, "%s,%d,%s,%s,%s,%s,%d,%d,%d,%d,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+		        record.mode, record.exercise, record.step, record.layout, record.simd, record.exchange,
+		        record.threads, record.ranks, record.width, record.height, record.warmup, record.iterations,
+		        record.time, record.exchange_time, record.mlups, record.speedup, record.efficiency);
+		fclose(fp);
+	}
+
+	//print the efficiency table of all the runs
+	if (rank == RANK_MASTER)
+	{
+		printf("================== SCALING ===================\n");
+		printf("%-6s %3s %-7s %-6s %-7s %-10s %7s %5s %11s %10s %10s %10s %8s %6s\n",
+		       "mode", "ex", "step", "layout", "simd", "exchange", "threads", "ranks", "mesh", "time (s)", "exch (s)", "MLUPS", "speedup", "eff");
+		for ( i = 0 ; i < count ; i++ )
+		{
+			lbm_scaling_compute_efficiency(&records[i], records, count);
+			printf("%-6s %3d %-7s %-6s %-7s %-10s %7d %5d %5dx%-5d %10.4f %10.4f %10.2f %8.2f %6.2f\n",
+			       records[i].mode, records[i].exercise, records[i].step, records[i].layout, records[i].simd, records[i].exchange,
+			       records[i].threads, records[i].ranks, records[i].width, records[i].height,
+			       records[i].time, records[i].exchange_time, records[i].mlups, records[i].speedup, records[i].efficiency);
+		}
+		printf("==============================================\n");
+		if (arguments.json != NULL)
+			lbm_scaling_write_json(arguments.json, records, count);
+		free(records);
+	}
+
+	//close MPI
+	MPI_Finalize();
+	return EXIT_SUCCESS;
+}
@@ -87,6 +87,8 @@ static char doc[] = "A simple checker for communication developpement for LBM.";
 		{"exercise",      'e', "EXID",   0, "ID of the exercice to execute." },
 		{"show",          's', "MODE",   0, "Show expected value on error: 'current', 'expected', or 'both'"},
 		{"pattern",       'p', "PATTERN",0, "Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'."},
+		{"layout",        'l', "LAYOUT", 0, "Memory layout of the mesh cells: 'aos' or 'soa'."},
+		{"exchange",      'x', "MODE",   0, "Ghost cells exchange to use: 'exercise', 'persistent', 'directional', 'shared' or 'rma'."},
 		{ 0 }
 	};
 #else
@@ -96,16 +98,20 @@ static char doc[] = "A simple checker for communication developpement for LBM.";
 			{ "exercise",   required_argument,      NULL,           'e' },
 			{ "show",       required_argument,      NULL,           's' },
 			{ "pattern",    required_argument,      NULL,           'p' },
+			{ "layout",     required_argument,      NULL,           'l' },
+			{ "exchange",   required_argument,      NULL,           'x' },
 			{ "help",       no_argument,            NULL,           '?' },
 			{ NULL,         0,                      NULL,           0 }
 	};
-	static const char * short_options = "[-w WIDTH] [-h HEIGHT] [-e EXID] [-s MODE] [-p PATTERN]";
+	static const char * short_options = "[-w WIDTH] [-h HEIGHT] [-e EXID] [-s MODE] [-p PATTERN] [-l LAYOUT] [-x MODE]";
 	static const char * help_message = 
 		"-w/--with     {WIDTH}   Total width of the mesh to compute and print.\n"
 		"-h/--height   {HEIGHT}  Total height of the mesh to compute and print.\n"
 		"-e/--exercise {EXID}    ID of the exercise to execute\n"
 		"-s/--show     {MODE}    Show expected value on error: 'current', 'expected', or 'both'.\n"
-		"-p/--pattern  {PATTERN} Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'.\n";
+		"-p/--pattern  {PATTERN} Define how to fill the mesh: 'rank', 'modulo9', 'modulo10' or 'position'.\n"
+		"-l/--layout   {LAYOUT}  Memory layout of the mesh cells: 'aos' or 'soa'.\n"
+		"-x/--exchange {MODE}    Ghost cells exchange to use: 'exercise', 'persistent', 'directional', 'shared' or 'rma'.\n";
 #endif
 
 /****************************************************/
@@ -117,6 +123,8 @@ struct arguments
 	int height;
 	lbm_show_mode_t show;
 	lbm_fill_mode_t fill;
+	lbm_mesh_layout_t layout;
+	lbm_exchange_mode_t exchange;
 };
 
 /****************************************************/
@@ -160,6 +168,12 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 			else
 				fatal("Invalid value for -s/--show option !");
 			break;
+		case 'l':
+			arguments->layout = lbm_config_parse_mesh_layout(arg);
+			break;
+		case 'x':
+			arguments->exchange = lbm_config_parse_exchange_mode(arg);
+			break;
 		case ARGP_KEY_ARG:
 			argp_usage (state);
 			break;
@@ -179,22 +193,20 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 #endif
 
 /****************************************************/
-int get_rank_at(lbm_comm_t * comm, lbm_coords_t * coords, int world_size, int x, int y, int outvalue)
+/**
+ * Rank at position (x, y) in the process grid, grid[] is indexed line by line and
+ * filled from the gathered coordinates as the ranks may be reordered (exercise 7).
+**/
+int get_rank_at(lbm_comm_t * comm, const int * grid, int x, int y, int outvalue)
 {
 	//outside
 	if (x < 0 || y < 0)
 		return outvalue;
 	if (x >= comm->nb_x || y >= comm->nb_y)
 		return outvalue;
-	
-	//search
-	int rank;
-	for (rank = 0 ; rank < world_size ; rank++)
-		if (coords[rank][0] == x && coords[rank][1] == y)
-			break;
 
 	//return
-	return rank;
+	return grid[y * comm->nb_x + x];
 }
 
 /****************************************************/
@@ -204,16 +216,39 @@ bool is_on_border(lbm_comm_t * comm, int col, int line)
 }
 
 /****************************************************/
-int calc_expected_value(lbm_comm_t * comm, lbm_coords_t * coords, int x, int y, int col, int line, int rank, int world_size, lbm_fill_mode_t fill)
+/**
+ * Tell if the population k of a ghost cell is received from the neighboor at (dx,dy). The
+ * directional exchange only sends the populations crossing toward us, the others keep the
+ * local value (same condition than lbm_comm_use_directional()).
+**/
+bool is_population_received(int dx, int dy, int k)
 {
-	//easy case
-	if (fill == LBM_FILL_POSITION)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line);
-	else if (fill == LBM_FILL_MODULO_9)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%9;
-	else if (fill == LBM_FILL_MODULO_10)
-		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%10;
+	if (dx == 0 && dy == 0)
+		return true;
+	if (EXCHANGE_MODE != LBM_EXCHANGE_DIRECTIONAL || (STEP_MODE != LBM_STEP_CLASSIC && STEP_MODE != LBM_STEP_OVERLAP))
+		return true;
+	return (dx == 0 || direction_matrix[k][0] == -dx) && (dy == 0 || direction_matrix[k][1] == -dy);
+}
+
+/****************************************************/
+/** First population of the cell received from the neighboor at (dx,dy), used as its value. **/
+int get_reference_population(int dx, int dy)
+{
+	int k;
+	for (k = 0 ; k < DIRECTIONS ; k++)
+		if (is_population_received(dx, dy, k))
+			return k;
+	return 0;
+}
 
+/****************************************************/
+/**
+ * Compute the value expected in the cell (col, line) of the rank at (x, y).
+ * @param from_dx Filled with the position of the neighboor the cell is received from, 0 if not a ghost cell.
+ * @param from_dy Filled with the position of the neighboor the cell is received from, 0 if not a ghost cell.
+**/
+int calc_expected_value(lbm_comm_t * comm, const int * grid, int x, int y, int col, int line, int rank, lbm_fill_mode_t fill, int * from_dx, int * from_dy)
+{
 	//calc expect location
 	int dx = 0;
 	int dy = 0;
@@ -225,9 +260,29 @@ int calc_expected_value(lbm_comm_t * comm, lbm_coords_t * coords, int x, int y,
 	if (line == comm->height-1 && comm->nb_y > 1) dy=+1;
 
 	//get expect
-	int expect1 = get_rank_at(comm, coords, world_size, x+dx, y+dy, -1);
-	int expect2 = get_rank_at(comm, coords, world_size, x+dx, y, -1);
-	int expect3 = get_rank_at(comm, coords, world_size, x, y+dy, -1);
+	int expect1 = get_rank_at(comm, grid, x+dx, y+dy, -1);
+	int expect2 = get_rank_at(comm, grid, x+dx, y, -1);
+	int expect3 = get_rank_at(comm, grid, x, y+dy, -1);
+
+	//where it comes from, same order than below
+	*from_dx = 0;
+	*from_dy = 0;
+	if (expect1 != -1) {
+		*from_dx = dx;
+		*from_dy = dy;
+	} else if (expect2 != -1) {
+		*from_dx = dx;
+	} else if (expect3 != -1) {
+		*from_dy = dy;
+	}
+
+	//easy case
+	if (fill == LBM_FILL_POSITION)
+		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line);
+	else if (fill == LBM_FILL_MODULO_9)
+		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%9;
+	else if (fill == LBM_FILL_MODULO_10)
+		return ((x * (comm->width-2) + col) * (comm->height) + (y * (comm->height-2)) + line)%10;
 
 	//return the one not -1 or rank
 	if (expect1 != -1) return expect1;
@@ -237,17 +292,21 @@ int calc_expected_value(lbm_comm_t * comm, lbm_coords_t * coords, int x, int y,
 }
 
 /****************************************************/
-bool check_cell_values(char * our_error_msg, lbm_mesh_cell_t cell, int x, int y, int col, int line)
+/**
+ * Check the populations of the cell are the same, for the ghost cells only the ones
+ * received from the neighboor at (from_dx, from_dy) are checked.
+**/
+bool check_cell_values(char * our_error_msg, lbm_mesh_cell_t cell, int x, int y, int col, int line, int from_dx, int from_dy)
 {
 	//vars
 	int k;
-	int value = (int)cell[0];
+	int value = (int)cell[get_reference_population(from_dx, from_dy)];
 
 	//check inner
 	for (k = 0 ; k < DIRECTIONS ; k++) {
-		if ((int)cell[k] != value) {
+		if (is_population_received(from_dx, from_dy, k) && (int)cell[k] != value) {
 			//fill message
-			sprintf(our_error_msg, YELLOW "Error inside cell, all 9 direction not valid (should be same): rank=(%d, %d) coord=(%d, %d)\ncell=[%f, %f, %f, %f, %f, %f, %f, %f, %f]" RESET "\n",
+			sprintf(our_error_msg, YELLOW "Error inside cell, the received directions are not valid (should be same): rank=(%d, %d) coord=(%d, %d)\ncell=[%f, %f, %f, %f, %f, %f, %f, %f, %f]" RESET "\n",
 				x, y,
 				col, line,
 				cell[0], cell[1], cell[2],
@@ -318,7 +377,7 @@ void disaply_value(int value, int expected, bool is_border, bool err_cell, lbm_s
 }
 
 /****************************************************/
-void display_meshes(lbm_comm_t * comm, lbm_mesh_t * mesh_rank, lbm_coords_t * coords, int world_size, lbm_show_mode_t show, lbm_fill_mode_t fill)
+void display_meshes(lbm_comm_t * comm, lbm_mesh_t * mesh_rank, const int * grid, lbm_show_mode_t show, lbm_fill_mode_t fill)
 {
 	bool ok = true;
 	int x,y,col,line;
@@ -328,19 +387,21 @@ void display_meshes(lbm_comm_t * comm, lbm_mesh_t * mesh_rank, lbm_coords_t * co
 		for (line = 0 ; line < comm->height ; line++) {
 			for (x = 0 ; x < comm->nb_x ; x++) {
 				//found corresponding rank
-				int rank = get_rank_at(comm, coords, world_size, x, y, -1);
+				int rank = get_rank_at(comm, grid, x, y, -1);
 				assert(rank != -1);
 
 				//display mesh
 				for (col = 0 ; col < comm->width ; col++) {
 					//extract cell
-					lbm_mesh_cell_t cell = lbm_mesh_get_cell(&mesh_rank[rank], col, line);
-					int value = (int)cell[0];
+					double cell[DIRECTIONS];
+					int from_dx, from_dy;
+					lbm_mesh_load_cell(&mesh_rank[rank], col, line, cell);
 
 					//check
 					bool is_border = is_on_border(comm, col, line);
-					int expected = calc_expected_value(comm, coords, x, y, col, line, rank, world_size, fill);
-					bool err_cell = !check_cell_values(dim_error, cell, x, y, col, line);
+					int expected = calc_expected_value(comm, grid, x, y, col, line, rank, fill, &from_dx, &from_dy);
+					int value = (int)cell[get_reference_population(from_dx, from_dy)];
+					bool err_cell = !check_cell_values(dim_error, cell, x, y, col, line, from_dx, from_dy);
 
 					//display
 					disaply_value(value, expected, is_border, err_cell, show, fill);
@@ -378,7 +439,7 @@ void mesh_init_rank(lbm_mesh_t * mesh, int rank)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = rank;
+				*lbm_mesh_get_value(mesh, i, j, k) = rank;
 }
 
 /****************************************************/
@@ -391,19 +452,19 @@ void mesh_init_zero_ghost(lbm_mesh_t * mesh, lbm_comm_t * comm)
 	if (comm->x - 1 > 0)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, 0, j)[k] = 0;
+				*lbm_mesh_get_value(mesh, 0, j, k) = 0;
 	if (comm->x + 1 < comm->nb_x)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, mesh->width-1, j)[k] = 0;
+				*lbm_mesh_get_value(mesh, mesh->width-1, j, k) = 0;
 	if (comm->y - 1 > 0)
 		for ( i = 0 ; i <  mesh->width ; i++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, 0)[k] = 0;
+				*lbm_mesh_get_value(mesh, i, 0, k) = 0;
 	if (comm->y + 1 < comm->nb_y)
 		for ( i = 0 ; i <  mesh->width ; i++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, mesh->height-1)[k] = 0;
+				*lbm_mesh_get_value(mesh, i, mesh->height-1, k) = 0;
 }
 
 /****************************************************/
@@ -419,7 +480,7 @@ void mesh_init_mod(lbm_mesh_t * mesh, lbm_comm_t * comm, int modulo)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = ((comm->x + i) * mesh->height + comm->y + j)%modulo;
+				*lbm_mesh_get_value(mesh, i, j, k) = ((comm->x + i) * mesh->height + comm->y + j)%modulo;
 
 	//zero ghost
 	mesh_init_zero_ghost(mesh, comm);
@@ -438,7 +499,7 @@ void mesh_init_pos(lbm_mesh_t * mesh, lbm_comm_t * comm)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = ((comm->x + i) * mesh->height + comm->y + j);
+				*lbm_mesh_get_value(mesh, i, j, k) = ((comm->x + i) * mesh->height + comm->y + j);
 
 	//zero ghost
 	mesh_init_zero_ghost(mesh, comm);
@@ -465,7 +526,7 @@ void print_help_message(char ** argv)
 void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 {
 	int c;
-	while ( (c = getopt_long(argc, argv, "w:h:e:s:p:", long_options, NULL)) != -1) {
+	while ( (c = getopt_long(argc, argv, "w:h:e:s:p:l:x:", long_options, NULL)) != -1) {
 		switch(c) {
 			case 'w':
 				arguments->width = atoi(optarg);
@@ -498,6 +559,12 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 				else
 					fatal("Invalid value for -s/--show option !");
 				break;
+			case 'l':
+				arguments->layout = lbm_config_parse_mesh_layout(optarg);
+				break;
+			case 'x':
+				arguments->exchange = lbm_config_parse_exchange_mode(optarg);
+				break;
 			case '?':
 				print_help_message(argv);
 				exit(0);
@@ -542,6 +609,8 @@ int main(int argc, char * argv[])
 		.height = 16,
 		.show = LBM_SHOW_CURRENT,
 		.fill = LBM_FILL_MODULO_9,
+		.layout = LBM_LAYOUT_AOS,
+		.exchange = LBM_EXCHANGE_EXERCISE,
 	};
 	parse_prgm_arguments(&arguments, argc, argv);
 
@@ -562,6 +631,9 @@ int main(int argc, char * argv[])
 	//setup
 	MESH_WIDTH = arguments.width;
 	MESH_HEIGHT = arguments.height;
+	MESH_LAYOUT = arguments.layout;
+	EXCHANGE_MODE = arguments.exchange;
+	HALO_DEPTH = 1;
 
 	//init mesh and comms
 	if ( rank == RANK_MASTER )
@@ -603,14 +675,17 @@ int main(int argc, char * argv[])
 
 	//get positions
 	int coords[64][2];
+	int grid[64];
 	MPI_Status status;
 	coords[0][0] = comm.rank_x;
 	coords[0][1] = comm.rank_y;
 	if (rank == RANK_MASTER) {
 		for (i = 1 ; i < comm_size ; i++)
 			MPI_Recv( coords[i], 2, MPI_INT, i, 0, MPI_COMM_WORLD, &status );
-		for (i = 0 ; i < comm_size ; i++)
+		for (i = 0 ; i < comm_size ; i++) {
 			printf(" * Rank %d: (%d, %d)\n", i, coords[i][0], coords[i][1]);
+			grid[coords[i][1] * comm.nb_x + coords[i][0]] = i;
+		}
 	} else {
 		MPI_Send( coords[0], 2, MPI_INT, 0, 0, MPI_COMM_WORLD);
 	}
@@ -633,7 +708,7 @@ int main(int argc, char * argv[])
 		for (i = 1 ; i < comm_size ; i++)
 			MPI_Recv( mesh_rank[i].cells, mesh_rank[i].width * mesh_rank[i].height * DIRECTIONS, MPI_DOUBLE, i, i, MPI_COMM_WORLD, &status );
 		printf(" * display...\n");
-		display_meshes(&comm, mesh_rank, coords, comm_size, arguments.show, arguments.fill);
+		display_meshes(&comm, mesh_rank, grid, arguments.show, arguments.fill);
 	} else {
 		MPI_Send( mesh.cells, mesh.width * mesh.height * DIRECTIONS, MPI_DOUBLE, 0, rank, MPI_COMM_WORLD );
 	}
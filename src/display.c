@@ -9,6 +9,7 @@
 /********************  HEADERS  *********************/
 
 #include <stdio.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -16,8 +17,14 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 #include "lbm_struct.h"
+#include "display_image.h"
+#include "display_hash.h"
 
 /*******************  ENUM  *********************/
 
@@ -26,9 +33,35 @@ typedef enum lbm_output_format_e
 	OUT_FORMAT_GNUPLOT,
 	OUT_FORMAT_OCTAVE,
 	OUT_FORMAT_CHECKSUM,
-	OUT_FORMAT_INFO
+	OUT_FORMAT_INFO,
+	OUT_FORMAT_PNG,
+	OUT_FORMAT_GIF,
+	OUT_FORMAT_HASH,
+	OUT_FORMAT_DIFF
 } lbm_output_format_t;
 
+/********************  GLOBALS  *********************/
+
+/** Image file to write with --png and --gif, a printf() pattern with the frame id for --png with --frames. **/
+const char * image_filename = NULL;
+
+/*******************  STRUCT  ***********************/
+
+/** Frames selected by --frames first:last[:stride], last is excluded. **/
+typedef struct lbm_frame_range_s
+{
+	int first;
+	int last;
+	int stride;
+} lbm_frame_range_t;
+
+/********************  CONSTS  **********************/
+
+/** Number of frames processed in parallel by thread, the next batch is prefetched meanwhile. **/
+#define FRAMES_PER_THREAD 4
+/** Number of columns of the tiles hashed or compared in parallel inside a frame. **/
+#define TILE_COLUMNS 64
+
 /*******************  FUNCTION  *********************/
 
 void fatal(const char * message)
@@ -41,6 +74,10 @@ void fatal(const char * message)
 
 void open_data_file(lbm_data_file_t * file,const char * fname)
 {
+	//vars
+	struct stat info;
+	void * mapping;
+
 	//errors
 	assert(file != NULL);
 	assert(fname != NULL);
@@ -73,8 +110,23 @@ void open_data_file(lbm_data_file_t * file,const char * fname)
 	if (file->header.magick != RESULT_MAGICK)
 		fatal("Invalid file format.");
 
-	//allocate memory
-	file->entries = malloc(file->header.mesh_height * file->header.mesh_width * sizeof(lbm_file_entry_t));
+	//map the whole file, the frames are then addressed directly without copy
+	file->mapping = NULL;
+	file->size = 0;
+	file->offset = sizeof(file->header);
+	if (fstat(fileno(file->fp), &info) == 0 && info.st_size > 0)
+	{
+		file->size = info.st_size;
+		mapping = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fileno(file->fp), 0);
+		if (mapping != MAP_FAILED)
+			file->mapping = mapping;
+	}
+
+	//fallback on fread() if the file cannot be mapped
+	if (file->mapping != NULL)
+		file->entries = NULL;
+	else
+		file->entries = malloc(file->header.mesh_height * file->header.mesh_width * sizeof(lbm_file_entry_t));
 }
 
 /*******************  FUNCTION  *********************/
@@ -84,13 +136,15 @@ void close_data_file(lbm_data_file_t * file)
 	//errors
 	assert(file != NULL);
 	assert(file->fp != NULL);
-	assert(file->entries != NULL);
 
 	//close
 	fclose(file->fp);
 
 	//free mem
-	free(file->entries);
+	if (file->mapping != NULL)
+		munmap(file->mapping, file->size);
+	else
+		free(file->entries);
 }
 
 /*******************  FUNCTION  *********************/
@@ -103,9 +157,20 @@ bool read_next_frame(lbm_data_file_t * file)
 	//errors
 	assert(file != NULL);
 	assert(file->fp != NULL);
-	assert(file->entries != NULL);
+
+	//point the frame in the mapping
+	if (file->mapping != NULL)
+	{
+		size_t frame_size = sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width;
+		if (file->offset + frame_size > file->size)
+			return false;
+		file->entries = (lbm_file_entry_t*)(file->mapping + file->offset);
+		file->offset += frame_size;
+		return true;
+	}
 
 	//load the frame
+	assert(file->entries != NULL);
 	res = fread(file->entries,sizeof(lbm_file_entry_t),file->header.mesh_height * file->header.mesh_width,file->fp);
 
 	if (res != file->header.mesh_height * file->header.mesh_width)
@@ -126,10 +191,64 @@ bool read_next_frame(lbm_data_file_t * file)
 
 bool seek_to_frame(lbm_data_file_t * file,int frame)
 {
+	//move in the mapping
+	if (file->mapping != NULL)
+	{
+		file->offset += (size_t)frame * sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width;
+		return true;
+	}
+
 	int res = fseek(file->fp,frame * sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width,SEEK_CUR);
 	return (res == 0);
 }
 
+/*******************  FUNCTION  *********************/
+/** Load the given frame whatever the current position is. **/
+bool load_frame(lbm_data_file_t * file,int frame)
+{
+	size_t frame_size = sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width;
+	size_t offset = sizeof(file->header) + (size_t)frame * frame_size;
+
+	if (file->mapping != NULL)
+		file->offset = offset;
+	else if (fseek(file->fp,offset,SEEK_SET) != 0)
+		return false;
+	return read_next_frame(file);
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Address of a frame in the mapping, the frames can then be processed in parallel.
+ * Return NULL if the file is not mapped or the frame is not complete.
+**/
+const lbm_file_entry_t * get_mapped_frame(lbm_data_file_t * file,int frame)
+{
+	size_t frame_size = sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width;
+	size_t offset = sizeof(file->header) + (size_t)frame * frame_size;
+
+	if (file->mapping == NULL || offset + frame_size > file->size)
+		return NULL;
+	return (const lbm_file_entry_t*)(file->mapping + offset);
+}
+
+/*******************  FUNCTION  *********************/
+/** Ask the kernel to read ahead the frames [first,last[ of the mapping. **/
+void prefetch_frames(lbm_data_file_t * file,int first,int last)
+{
+	size_t frame_size = sizeof(lbm_file_entry_t) * file->header.mesh_height * file->header.mesh_width;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t start = sizeof(file->header) + (size_t)first * frame_size;
+	size_t end = sizeof(file->header) + (size_t)last * frame_size;
+
+	if (file->mapping == NULL || first >= last)
+		return;
+	if (end > file->size)
+		end = file->size;
+	start -= start % page;
+	if (start < end)
+		madvise(file->mapping + start, end - start, MADV_WILLNEED);
+}
+
 /*******************  FUNCTION  *********************/
 
 void print_current_frame_gnuplot(lbm_data_file_t * file)
@@ -160,37 +279,52 @@ void print_current_frame_gnuplot(lbm_data_file_t * file)
 
 /*******************  FUNCTION  *********************/
 
-double checksum = 0;
-
-void do_checksum(lbm_data_file_t * file)
+double frame_checksum(const lbm_file_header_t * header,const lbm_file_entry_t * entries)
 {
 	//vars
 	uint32_t i,j,l;
 	int pos;
+	double checksum = 0;
 	
 	//calc line_height
-	int line_height = file->header.mesh_height / file->header.lines;
+	int line_height = header->mesh_height / header->lines;
 	
 	//loop on datas
-	for ( i = 0 ; i < file->header.mesh_width ; i++)
+	for ( i = 0 ; i < header->mesh_width ; i++)
 	{
-		for ( l = 0 ; l < file->header.lines ; l++)
+		for ( l = 0 ; l < header->lines ; l++)
 		{
 			for ( j = 0 ; j < line_height ; j++)
 			{
-				pos = line_height * i + j + l * line_height * file->header.mesh_width;
-				checksum += file->entries[pos].density + file->entries[pos].v;
+				pos = line_height * i + j + l * line_height * header->mesh_width;
+				checksum += entries[pos].density + entries[pos].v;
 			}
 		}
 	}
 
+	return checksum;
+}
+
+/*******************  FUNCTION  *********************/
+
+void print_checksum(double checksum)
+{
 	printf("%llX - %g\n", (unsigned long long int)checksum ,checksum);
 }
 
+/*******************  FUNCTION  *********************/
+
+void do_checksum(lbm_data_file_t * file)
+{
+	print_checksum(frame_checksum(&file->header,file->entries));
+}
+
 /*******************  FUNCTION  *********************/
 int get_frame_count(lbm_data_file_t * file)
 {
 	struct stat info;
+	if (file->mapping != NULL)
+		return file->size / (file->header.mesh_width * file->header.mesh_height * sizeof(lbm_file_entry_t));
 	if (fstat(fileno(file->fp), &info) == 0)
 		return info.st_size / (file->header.mesh_width * file->header.mesh_height * sizeof(lbm_file_entry_t));
 	else
@@ -205,9 +339,391 @@ void print_info(lbm_data_file_t * file)
 	printf("frames=%d\n",get_frame_count(file));
 }
 
+/*******************  STRUCT  ***********************/
+
+/** Summary of a frame printed by --info with --frames. **/
+typedef struct lbm_frame_info_s
+{
+	double v_max;
+	double v_mean;
+	double density_mean;
+	int obstacles;
+} lbm_frame_info_t;
+
+/*******************  FUNCTION  *********************/
+
+void frame_info(const lbm_file_header_t * header,const lbm_file_entry_t * entries,lbm_frame_info_t * info)
+{
+	size_t i, count = (size_t)header->mesh_width * header->mesh_height;
+
+	memset(info,0,sizeof(*info));
+	for ( i = 0 ; i < count ; i++)
+	{
+		//obstacles are NaN
+		if (entries[i].v != entries[i].v) {
+			info->obstacles++;
+			continue;
+		}
+		if (entries[i].v > info->v_max)
+			info->v_max = entries[i].v;
+		info->v_mean += entries[i].v;
+		info->density_mean += entries[i].density;
+	}
+	if (count > (size_t)info->obstacles) {
+		info->v_mean /= count - info->obstacles;
+		info->density_mean /= count - info->obstacles;
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+void print_frame_info(int frame,const lbm_frame_info_t * info)
+{
+	printf("frame=%d v_max=%g v_mean=%g density_mean=%g obstacles=%d\n",frame,info->v_max,info->v_mean,info->density_mean,info->obstacles);
+}
+
+/*******************  FUNCTION  *********************/
+/** Position in the entries of the cell (x,y) of the global mesh, the file stores it by lines of ranks. **/
+static inline size_t get_entry_pos(const lbm_file_header_t * header,uint32_t x,uint32_t y)
+{
+	uint32_t line_height = header->mesh_height / header->lines;
+	return (size_t)line_height * x + y % line_height + (size_t)(y / line_height) * line_height * header->mesh_width;
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Hash of a frame independent of the number of lines of ranks used to write it. The cells
+ * are hashed in the global column-major order by tiles of TILE_COLUMNS columns (XXH64),
+ * the hash of the frame is the XXH64 of the hashes of the tiles. The tiles are done in
+ * parallel.
+**/
+uint64_t frame_hash(const lbm_file_header_t * header,const lbm_file_entry_t * entries)
+{
+	//vars
+	int t;
+	int tiles = (header->mesh_width + TILE_COLUMNS - 1) / TILE_COLUMNS;
+	uint64_t * hashes = malloc(tiles * sizeof(uint64_t));
+	uint64_t res;
+	uint32_t line_height = header->mesh_height / header->lines;
+
+	//tiles
+	#pragma omp parallel for schedule(dynamic)
+	for (t = 0 ; t < tiles ; t++)
+	{
+		display_hash_t hash;
+		uint32_t i, l;
+		display_hash_init(&hash, 0);
+		for (i = t * TILE_COLUMNS ; i < (uint32_t)(t + 1) * TILE_COLUMNS && i < header->mesh_width ; i++)
+			for (l = 0 ; l < header->lines ; l++)
+				display_hash_update(&hash, &entries[get_entry_pos(header, i, l * line_height)], line_height * sizeof(lbm_file_entry_t));
+		hashes[t] = display_hash_final(&hash);
+	}
+
+	//merge
+	res = display_hash(hashes, tiles * sizeof(uint64_t), 0);
+	free(hashes);
+	return res;
+}
+
+/*******************  FUNCTION  *********************/
+
+void print_hash(int frame,uint64_t hash)
+{
+	printf("frame=%d hash=%016llx\n",frame,(unsigned long long)hash);
+}
+
+/*******************  STRUCT  ***********************/
+
+/** Differences between a frame and the reference one. **/
+typedef struct lbm_frame_diff_s
+{
+	/** First cell out of the tolerance in the global column-major order, -1 if none. **/
+	long first;
+	/** Number of cells out of the tolerance. **/
+	long cells;
+	/** Largest difference, infinite if a NaN (obstacle) is not at the same place. **/
+	double max_diff;
+} lbm_frame_diff_t;
+
+/*******************  FUNCTION  *********************/
+/** Difference of two values, the NaN of the obstacles must match. **/
+static inline double value_diff(float value,float ref)
+{
+	if (isnan(value) || isnan(ref))
+		return (isnan(value) && isnan(ref)) ? 0.0 : INFINITY;
+	return fabs((double)value - (double)ref);
+}
+
+/*******************  FUNCTION  *********************/
+/** Compare a frame to the reference one cell by cell, the tiles are done in parallel. **/
+void frame_diff(const lbm_file_header_t * header,const lbm_file_entry_t * entries,
+                const lbm_file_header_t * ref_header,const lbm_file_entry_t * ref_entries,
+                double tolerance,lbm_frame_diff_t * diff)
+{
+	//vars
+	int t;
+	int tiles = (header->mesh_width + TILE_COLUMNS - 1) / TILE_COLUMNS;
+	lbm_frame_diff_t * tile_diffs = malloc(tiles * sizeof(lbm_frame_diff_t));
+
+	//tiles
+	#pragma omp parallel for schedule(dynamic)
+	for (t = 0 ; t < tiles ; t++)
+	{
+		uint32_t i, j;
+		double d, dv, ddensity;
+		lbm_frame_diff_t * tile = &tile_diffs[t];
+		tile->first = -1;
+		tile->cells = 0;
+		tile->max_diff = 0.0;
+		for (i = t * TILE_COLUMNS ; i < (uint32_t)(t + 1) * TILE_COLUMNS && i < header->mesh_width ; i++)
+		{
+			for (j = 0 ; j < header->mesh_height ; j++)
+			{
+				const lbm_file_entry_t * cell = &entries[get_entry_pos(header, i, j)];
+				const lbm_file_entry_t * ref = &ref_entries[get_entry_pos(ref_header, i, j)];
+				dv = value_diff(cell->v, ref->v);
+				ddensity = value_diff(cell->density, ref->density);
+				d = (dv > ddensity) ? dv : ddensity;
+				if (d > tile->max_diff)
+					tile->max_diff = d;
+				if (d > tolerance) {
+					if (tile->first == -1)
+						tile->first = (long)i * header->mesh_height + j;
+					tile->cells++;
+				}
+			}
+		}
+	}
+
+	//merge, the tiles are in the column-major order
+	diff->first = -1;
+	diff->cells = 0;
+	diff->max_diff = 0.0;
+	for (t = 0 ; t < tiles ; t++) {
+		if (diff->first == -1)
+			diff->first = tile_diffs[t].first;
+		diff->cells += tile_diffs[t].cells;
+		if (tile_diffs[t].max_diff > diff->max_diff)
+			diff->max_diff = tile_diffs[t].max_diff;
+	}
+	free(tile_diffs);
+}
+
+/*******************  FUNCTION  *********************/
+
+void write_png(lbm_data_file_t * file,int frame)
+{
+	//vars
+	display_image_t image;
+	char filename[4096];
+
+	//name, can contain the frame id
+	if (strchr(image_filename,'%') != NULL)
+		snprintf(filename,sizeof(filename),image_filename,frame);
+	else
+		snprintf(filename,sizeof(filename),"%s",image_filename);
+
+	//render
+	display_image_init(&image, file->header.mesh_width, file->header.mesh_height,
+	                   display_image_auto_scale(file->header.mesh_width, file->header.mesh_height));
+	display_image_render(&image, &file->header, file->entries);
+
+	//write
+	if (display_image_write_png(&image, filename) != 0)
+		fatal("Fail to write the image.");
+	display_image_release(&image);
+}
+
 /*******************  FUNCTION  *********************/
 
-void print_current_frame(lbm_data_file_t * file,lbm_output_format_t format)
+int get_batch_size(void)
+{
+	#ifdef _OPENMP
+		return FRAMES_PER_THREAD * omp_get_max_threads();
+	#else
+		return FRAMES_PER_THREAD;
+	#endif
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Render the selected frames into an animated GIF. The frames are processed by batches,
+ * the rendering and LZW compression of a batch are done in parallel then the frames are
+ * written in order.
+**/
+void write_gif(lbm_data_file_t * file,const lbm_frame_range_t * range)
+{
+	//vars
+	int f, frame, count;
+	FILE * fp;
+	int scale = display_image_auto_scale(file->header.mesh_width, file->header.mesh_height);
+	int batch = get_batch_size();
+	display_image_t * images = malloc(batch * sizeof(display_image_t));
+	const lbm_file_entry_t ** entries = malloc(batch * sizeof(lbm_file_entry_t*));
+	uint8_t ** data = malloc(batch * sizeof(uint8_t*));
+	size_t * sizes = malloc(batch * sizeof(size_t));
+	for (f = 0 ; f < batch ; f++)
+		display_image_init(&images[f], file->header.mesh_width, file->header.mesh_height, scale);
+
+	//open
+	fp = fopen(image_filename, "wb");
+	if (fp == NULL) {
+		perror(image_filename);
+		abort();
+	}
+	display_image_gif_begin(fp, images[0].width, images[0].height);
+
+	//loop on batches
+	for (frame = range->first ; frame < range->last ; frame += count * range->stride)
+	{
+		//get the frames, without the mapping they are rendered while read
+		for (count = 0 ; count < batch && frame + count * range->stride < range->last ; count++) {
+			if (load_frame(file, frame + count * range->stride) == false)
+				break;
+			entries[count] = file->entries;
+			if (file->mapping == NULL)
+				display_image_render(&images[count], &file->header, entries[count]);
+		}
+		if (count == 0)
+			break;
+		prefetch_frames(file, frame + count * range->stride, frame + 2 * count * range->stride);
+
+		//render & compress
+		#pragma omp parallel for schedule(dynamic)
+		for (f = 0 ; f < count ; f++) {
+			if (file->mapping != NULL)
+				display_image_render(&images[f], &file->header, entries[f]);
+			sizes[f] = display_image_gif_encode(&images[f], &data[f]);
+		}
+
+		//write in order
+		for (f = 0 ; f < count ; f++) {
+			display_image_gif_frame(fp, images[f].width, images[f].height, data[f], sizes[f]);
+			free(data[f]);
+		}
+	}
+
+	//close
+	display_image_gif_end(fp);
+	fclose(fp);
+
+	//free
+	for (f = 0 ; f < batch ; f++)
+		display_image_release(&images[f]);
+	free(images);
+	free(entries);
+	free(data);
+	free(sizes);
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Compare the selected frames of a file to a reference one with a tolerance on the
+ * velocity and the density. Print the frames out of the tolerance and the first divergent
+ * cell, the frames are compared in parallel by batches when both files are mapped.
+ * @return true if all the frames are within the tolerance.
+**/
+bool diff_files(lbm_data_file_t * file,lbm_data_file_t * ref,double tolerance,const lbm_frame_range_t * range)
+{
+	//vars
+	int f, frame, count, last;
+	int batch = get_batch_size();
+	int frames = get_frame_count(file);
+	int ref_frames = get_frame_count(ref);
+	int first_frame = -1, diff_frames = 0;
+	long first_cell = -1;
+	double max_diff = 0.0;
+	bool mapped = (file->mapping != NULL && ref->mapping != NULL);
+	const lbm_file_entry_t ** entries;
+	const lbm_file_entry_t ** ref_entries;
+	lbm_frame_diff_t * diffs;
+
+	//headers
+	printf("frames=%d reference_frames=%d tolerance=%g\n",frames,ref_frames,tolerance);
+	if (file->header.mesh_width != ref->header.mesh_width || file->header.mesh_height != ref->header.mesh_height) {
+		printf("mesh size %dx%d differs from the reference %dx%d\n",file->header.mesh_width,file->header.mesh_height,
+		       ref->header.mesh_width,ref->header.mesh_height);
+		printf("result=DIFF\n");
+		return false;
+	}
+	last = (range->last < ref_frames) ? range->last : ref_frames;
+
+	//allocate
+	entries = malloc(batch * sizeof(lbm_file_entry_t*));
+	ref_entries = malloc(batch * sizeof(lbm_file_entry_t*));
+	diffs = malloc(batch * sizeof(lbm_frame_diff_t));
+
+	//loop on batches
+	for (frame = range->first ; frame < last ; frame += count * range->stride)
+	{
+		//frames of the batch, without the mapping they are compared while read
+		for (count = 0 ; count < batch && frame + count * range->stride < last ; count++) {
+			if (mapped) {
+				entries[count] = get_mapped_frame(file, frame + count * range->stride);
+				ref_entries[count] = get_mapped_frame(ref, frame + count * range->stride);
+				if (entries[count] == NULL || ref_entries[count] == NULL)
+					break;
+			} else {
+				if (load_frame(file, frame + count * range->stride) == false || load_frame(ref, frame + count * range->stride) == false)
+					break;
+				frame_diff(&file->header, file->entries, &ref->header, ref->entries, tolerance, &diffs[count]);
+			}
+		}
+		if (count == 0)
+			break;
+		prefetch_frames(file, frame + count * range->stride, frame + 2 * count * range->stride);
+		prefetch_frames(ref, frame + count * range->stride, frame + 2 * count * range->stride);
+
+		//compare
+		if (mapped) {
+			#pragma omp parallel for schedule(dynamic)
+			for (f = 0 ; f < count ; f++)
+				frame_diff(&file->header, entries[f], &ref->header, ref_entries[f], tolerance, &diffs[f]);
+		}
+
+		//report in order
+		for (f = 0 ; f < count ; f++) {
+			if (diffs[f].max_diff > max_diff)
+				max_diff = diffs[f].max_diff;
+			if (diffs[f].cells == 0)
+				continue;
+			printf("frame=%d cells=%ld max_diff=%g\n",frame + f * range->stride,diffs[f].cells,diffs[f].max_diff);
+			if (first_frame == -1) {
+				first_frame = frame + f * range->stride;
+				first_cell = diffs[f].first;
+			}
+			diff_frames++;
+		}
+	}
+
+	//summary
+	printf("max_diff=%g\n",max_diff);
+	if (first_frame != -1) {
+		uint32_t x = first_cell / file->header.mesh_height;
+		uint32_t y = first_cell % file->header.mesh_height;
+		load_frame(file, first_frame);
+		load_frame(ref, first_frame);
+		const lbm_file_entry_t * cell = &file->entries[get_entry_pos(&file->header, x, y)];
+		const lbm_file_entry_t * ref_cell = &ref->entries[get_entry_pos(&ref->header, x, y)];
+		printf("first_divergence: frame=%d x=%u y=%u v=%g ref_v=%g density=%g ref_density=%g\n",
+		       first_frame,x,y,cell->v,ref_cell->v,cell->density,ref_cell->density);
+		printf("diff_frames=%d\n",diff_frames);
+	}
+	if (frames != ref_frames)
+		printf("frame count differs from the reference\n");
+	printf("result=%s\n",(first_frame == -1 && frames == ref_frames) ? "OK" : "DIFF");
+
+	//free
+	free(entries);
+	free(ref_entries);
+	free(diffs);
+
+	return (first_frame == -1 && frames == ref_frames);
+}
+
+/*******************  FUNCTION  *********************/
+
+void print_current_frame(lbm_data_file_t * file,lbm_output_format_t format,int frame)
 {
 	switch(format)
 	{
@@ -224,6 +740,16 @@ void print_current_frame(lbm_data_file_t * file,lbm_output_format_t format)
 		case OUT_FORMAT_CHECKSUM :
 			do_checksum(file);
 			break;
+		case OUT_FORMAT_PNG:
+			write_png(file,frame);
+			break;
+		case OUT_FORMAT_HASH:
+			print_hash(frame,frame_hash(&file->header,file->entries));
+			break;
+		case OUT_FORMAT_GIF:
+		case OUT_FORMAT_DIFF:
+			fatal("The animations and comparisons are done by write_gif() and diff_files().");
+			break;
 	}
 }
 
@@ -239,8 +765,164 @@ void print_data(lbm_data_file_t * file,lbm_output_format_t format,int frame)
 	if (seek_to_frame(file,frame) == false)
 		fatal("Can't seek to the requested frame.");
 	//read
-	if (read_next_frame(file))
-		print_current_frame(file,format);
+	if (read_next_frame(file) == false)
+		fatal("The requested frame is not in the file.");
+	print_current_frame(file,format,frame);
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Checksum, hash or summary of the selected frames, computed in parallel by batches when the
+ * file is mapped and printed in order.
+**/
+void print_frames_parallel(lbm_data_file_t * file,lbm_output_format_t format,const lbm_frame_range_t * range)
+{
+	//vars
+	int f, frame, count;
+	int batch = get_batch_size();
+	const lbm_file_entry_t ** entries = malloc(batch * sizeof(lbm_file_entry_t*));
+	double * checksums = malloc(batch * sizeof(double));
+	uint64_t * hashes = malloc(batch * sizeof(uint64_t));
+	lbm_frame_info_t * infos = malloc(batch * sizeof(lbm_frame_info_t));
+
+	//loop on batches
+	for (frame = range->first ; frame < range->last ; frame += count * range->stride)
+	{
+		//frames of the batch
+		for (count = 0 ; count < batch && frame + count * range->stride < range->last ; count++)
+			if ((entries[count] = get_mapped_frame(file, frame + count * range->stride)) == NULL)
+				break;
+		if (count == 0)
+			break;
+		prefetch_frames(file, frame + count * range->stride, frame + 2 * count * range->stride);
+
+		//compute
+		#pragma omp parallel for schedule(dynamic)
+		for (f = 0 ; f < count ; f++) {
+			if (format == OUT_FORMAT_CHECKSUM)
+				checksums[f] = frame_checksum(&file->header, entries[f]);
+			else if (format == OUT_FORMAT_HASH)
+				hashes[f] = frame_hash(&file->header, entries[f]);
+			else
+				frame_info(&file->header, entries[f], &infos[f]);
+		}
+
+		//print in order
+		for (f = 0 ; f < count ; f++) {
+			if (format == OUT_FORMAT_CHECKSUM)
+				print_checksum(checksums[f]);
+			else if (format == OUT_FORMAT_HASH)
+				print_hash(frame + f * range->stride, hashes[f]);
+			else
+				print_frame_info(frame + f * range->stride, &infos[f]);
+		}
+	}
+
+	//free
+	free(entries);
+	free(checksums);
+	free(hashes);
+	free(infos);
+}
+
+/*******************  FUNCTION  *********************/
+/** Process the frames selected by --frames in a single pass over the file. **/
+void print_frames(lbm_data_file_t * file,lbm_output_format_t format,const lbm_frame_range_t * range)
+{
+	//vars
+	int frame;
+	lbm_frame_info_t info;
+
+	//errors
+	assert(file != NULL);
+	assert(range->first >= 0 && range->stride > 0);
+
+	//global infos first
+	if (format == OUT_FORMAT_INFO)
+		print_info(file);
+
+	//read ahead
+	if (file->mapping != NULL && range->stride == 1)
+		madvise(file->mapping, file->size, MADV_SEQUENTIAL);
+
+	//special cases
+	if (format == OUT_FORMAT_GIF) {
+		write_gif(file, range);
+		return;
+	} else if (file->mapping != NULL && (format == OUT_FORMAT_CHECKSUM || format == OUT_FORMAT_HASH || format == OUT_FORMAT_INFO)) {
+		print_frames_parallel(file, format, range);
+		return;
+	} else if (format == OUT_FORMAT_PNG && strchr(image_filename,'%') == NULL) {
+		fatal("The image name needs a pattern like frame-%05d.png to write several frames.");
+	}
+
+	//loop on frames in order
+	for (frame = range->first ; frame < range->last ; frame += range->stride)
+	{
+		if (load_frame(file,frame) == false)
+			break;
+		if (format == OUT_FORMAT_INFO) {
+			frame_info(&file->header, file->entries, &info);
+			print_frame_info(frame, &info);
+		} else {
+			print_current_frame(file,format,frame);
+		}
+	}
+}
+
+/*******************  FUNCTION  *********************/
+/** Parse the first[:last[:stride]] value of --frames, last and stride can be omitted or empty (first:, first::stride) to keep their defaults. **/
+void parse_frame_range(lbm_frame_range_t * range,const char * value,int frames)
+{
+	//vars
+	char * end;
+	bool parsed;
+
+	//first
+	range->first = strtol(value,&end,10);
+	range->last = frames;
+	range->stride = 1;
+	parsed = (end != value);
+
+	//last then stride, each one can be empty to keep its default
+	if (parsed && *end == ':') {
+		value = end + 1;
+		if (*value != ':' && *value != '\0') {
+			range->last = strtol(value,&end,10);
+			parsed = (end != value);
+		} else {
+			end = (char*)value;
+		}
+		if (parsed && *end == ':') {
+			value = end + 1;
+			if (*value != '\0') {
+				range->stride = strtol(value,&end,10);
+				parsed = (end != value);
+			} else {
+				end = (char*)value;
+			}
+		}
+	}
+
+	//errors
+	if (parsed == false || *end != '\0' || range->first < 0 || range->stride <= 0)
+		fatal("Invalid frame range, expect first[:last[:stride]].");
+	if (range->last > frames)
+		range->last = frames;
+	if (range->first >= range->last)
+		fatal("Invalid frame range, no frame of the file selected.");
+}
+
+/*******************  FUNCTION  *********************/
+
+void print_usage(const char * program)
+{
+	fprintf(stderr,"Usage : %s [--frames first[:last[:stride]]] {--gnuplot|--checksum|--hash|--info} {file.raw} {frame_id}\n",program);
+	fprintf(stderr,"        %s [--frames first[:last[:stride]]] --png {file.raw} {frame_id} {image.png}\n",program);
+	fprintf(stderr,"        %s [--frames first[:last[:stride]]] --gif {file.raw} {animation.gif}\n",program);
+	fprintf(stderr,"        %s [--frames first[:last[:stride]]] --diff {file.raw} {reference.raw} {tolerance}\n",program);
+	fprintf(stderr,"With --frames the frame_id is not given, the frames are processed in a single pass.\n");
+	abort();
 }
 
 /*******************  FUNCTION  *********************/
@@ -249,19 +931,25 @@ int main(int argc, char * argv[])
 {
 	//vars
 	lbm_data_file_t file;
+	lbm_data_file_t ref;
 	lbm_output_format_t format;
+	bool ok = true;
+	lbm_frame_range_t range;
+	const char * frames = NULL;
 	int frame = -1;
-	
-	//arg error
-	if (argc != 4)
-	{
-		fprintf(stderr,"Usage : %s {--gnuplot|--octave|--checksum|--info} {file.raw} {frame_id}\n",argv[0]);
-		abort();
+	int args;
+
+	//frame range
+	if (argc > 2 && strcmp(argv[1],"--frames") == 0) {
+		frames = argv[2];
+		argc -= 2;
+		argv += 2;
 	}
+	args = (frames == NULL) ? 4 : 3;
 
-	//open
-	open_data_file(&file,argv[2]);
-	frame = atoi(argv[3]);
+	//arg error
+	if (argc < 3)
+		print_usage(argv[0]);
 
 	//read args
 	if (strcmp(argv[1],"--gnuplot") == 0)
@@ -270,14 +958,54 @@ int main(int argc, char * argv[])
 		format = OUT_FORMAT_CHECKSUM;
 	else if (strcmp(argv[1],"--info") == 0)
 		format = OUT_FORMAT_INFO;
+	else if (strcmp(argv[1],"--png") == 0)
+		format = OUT_FORMAT_PNG;
+	else if (strcmp(argv[1],"--gif") == 0)
+		format = OUT_FORMAT_GIF;
+	else if (strcmp(argv[1],"--hash") == 0)
+		format = OUT_FORMAT_HASH;
+	else if (strcmp(argv[1],"--diff") == 0)
+		format = OUT_FORMAT_DIFF;
 	else		
 		fatal("Invalid format option.");
 
+	//the image formats have the output name in more, with --frames there is no frame_id
+	if (format == OUT_FORMAT_PNG)
+		args++;
+	else if (format == OUT_FORMAT_GIF)
+		args = 4;
+	else if (format == OUT_FORMAT_DIFF)
+		args = 5;
+	if (argc != args)
+		print_usage(argv[0]);
+
+	//open
+	open_data_file(&file,argv[2]);
+
 	//print
-	print_data(&file,format,frame);
+	if (format == OUT_FORMAT_DIFF) {
+		open_data_file(&ref,argv[3]);
+		parse_frame_range(&range, (frames == NULL) ? "0" : frames, get_frame_count(&file));
+		ok = diff_files(&file,&ref,atof(argv[4]),&range);
+		close_data_file(&ref);
+	} else if (format == OUT_FORMAT_GIF) {
+		image_filename = argv[3];
+		parse_frame_range(&range, (frames == NULL) ? "0" : frames, get_frame_count(&file));
+		write_gif(&file,&range);
+	} else if (frames != NULL) {
+		if (format == OUT_FORMAT_PNG)
+			image_filename = argv[3];
+		parse_frame_range(&range, frames, get_frame_count(&file));
+		print_frames(&file,format,&range);
+	} else {
+		frame = atoi(argv[3]);
+		if (format == OUT_FORMAT_PNG)
+			image_filename = argv[4];
+		print_data(&file,format,frame);
+	}
 
 	//close
 	close_data_file(&file);
 
-	return EXIT_SUCCESS;
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
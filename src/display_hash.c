@@ -0,0 +1,181 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/********************  HEADERS  *********************/
+
+#include <string.h>
+#include "display_hash.h"
+
+/********************  CONSTS  **********************/
+
+/** Primes of the XXH64 algorithm. **/
+#define DISPLAY_HASH_P1 0x9E3779B185EBCA87ULL
+#define DISPLAY_HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define DISPLAY_HASH_P3 0x165667B19E3779F9ULL
+#define DISPLAY_HASH_P4 0x85EBCA77C2B2AE63ULL
+#define DISPLAY_HASH_P5 0x27D4EB2F165667C5ULL
+
+/*******************  FUNCTION  *********************/
+
+static inline uint64_t display_hash_rotl(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/*******************  FUNCTION  *********************/
+/** Unaligned little endian loads (x86). **/
+static inline uint64_t display_hash_read64(const uint8_t * data)
+{
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+/*******************  FUNCTION  *********************/
+
+static inline uint32_t display_hash_read32(const uint8_t * data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+/*******************  FUNCTION  *********************/
+
+static inline uint64_t display_hash_round(uint64_t acc, uint64_t input)
+{
+	acc += input * DISPLAY_HASH_P2;
+	acc = display_hash_rotl(acc, 31);
+	return acc * DISPLAY_HASH_P1;
+}
+
+/*******************  FUNCTION  *********************/
+
+static inline uint64_t display_hash_merge(uint64_t acc, uint64_t value)
+{
+	acc ^= display_hash_round(0, value);
+	return acc * DISPLAY_HASH_P1 + DISPLAY_HASH_P4;
+}
+
+/*******************  FUNCTION  *********************/
+
+static inline void display_hash_stripe(display_hash_t * hash, const uint8_t * data)
+{
+	hash->v[0] = display_hash_round(hash->v[0], display_hash_read64(data));
+	hash->v[1] = display_hash_round(hash->v[1], display_hash_read64(data + 8));
+	hash->v[2] = display_hash_round(hash->v[2], display_hash_read64(data + 16));
+	hash->v[3] = display_hash_round(hash->v[3], display_hash_read64(data + 24));
+}
+
+/*******************  FUNCTION  *********************/
+
+void display_hash_init(display_hash_t * hash, uint64_t seed)
+{
+	memset(hash, 0, sizeof(*hash));
+	hash->seed = seed;
+	hash->v[0] = seed + DISPLAY_HASH_P1 + DISPLAY_HASH_P2;
+	hash->v[1] = seed + DISPLAY_HASH_P2;
+	hash->v[2] = seed;
+	hash->v[3] = seed - DISPLAY_HASH_P1;
+}
+
+/*******************  FUNCTION  *********************/
+
+void display_hash_update(display_hash_t * hash, const void * data, size_t size)
+{
+	const uint8_t * bytes = data;
+	size_t missing;
+
+	hash->total += size;
+
+	//complete the pending stripe
+	if (hash->buffered > 0) {
+		missing = 32 - hash->buffered;
+		if (size < missing) {
+			memcpy(hash->buffer + hash->buffered, bytes, size);
+			hash->buffered += size;
+			return;
+		}
+		memcpy(hash->buffer + hash->buffered, bytes, missing);
+		display_hash_stripe(hash, hash->buffer);
+		bytes += missing;
+		size -= missing;
+		hash->buffered = 0;
+	}
+
+	//full stripes
+	while (size >= 32) {
+		display_hash_stripe(hash, bytes);
+		bytes += 32;
+		size -= 32;
+	}
+
+	//keep the end
+	memcpy(hash->buffer, bytes, size);
+	hash->buffered = size;
+}
+
+/*******************  FUNCTION  *********************/
+
+uint64_t display_hash_final(const display_hash_t * hash)
+{
+	uint64_t h;
+	const uint8_t * p = hash->buffer;
+	size_t size = hash->buffered;
+
+	//lanes
+	if (hash->total >= 32) {
+		h = display_hash_rotl(hash->v[0], 1) + display_hash_rotl(hash->v[1], 7)
+		  + display_hash_rotl(hash->v[2], 12) + display_hash_rotl(hash->v[3], 18);
+		h = display_hash_merge(h, hash->v[0]);
+		h = display_hash_merge(h, hash->v[1]);
+		h = display_hash_merge(h, hash->v[2]);
+		h = display_hash_merge(h, hash->v[3]);
+	} else {
+		h = hash->seed + DISPLAY_HASH_P5;
+	}
+	h += hash->total;
+
+	//remaining bytes
+	while (size >= 8) {
+		h ^= display_hash_round(0, display_hash_read64(p));
+		h = display_hash_rotl(h, 27) * DISPLAY_HASH_P1 + DISPLAY_HASH_P4;
+		p += 8;
+		size -= 8;
+	}
+	if (size >= 4) {
+		h ^= (uint64_t)display_hash_read32(p) * DISPLAY_HASH_P1;
+		h = display_hash_rotl(h, 23) * DISPLAY_HASH_P2 + DISPLAY_HASH_P3;
+		p += 4;
+		size -= 4;
+	}
+	while (size > 0) {
+		h ^= (*p) * DISPLAY_HASH_P5;
+		h = display_hash_rotl(h, 11) * DISPLAY_HASH_P1;
+		p++;
+		size--;
+	}
+
+	//avalanche
+	h ^= h >> 33;
+	h *= DISPLAY_HASH_P2;
+	h ^= h >> 29;
+	h *= DISPLAY_HASH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*******************  FUNCTION  *********************/
+
+uint64_t display_hash(const void * data, size_t size, uint64_t seed)
+{
+	display_hash_t hash;
+	display_hash_init(&hash, seed);
+	display_hash_update(&hash, data, size);
+	return display_hash_final(&hash);
+}
@@ -0,0 +1,42 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef DISPLAY_HASH_H
+#define DISPLAY_HASH_H
+
+/****************************************************/
+#include <stdint.h>
+#include <stddef.h>
+
+/****************************************************/
+/**
+ * State of a streaming XXH64 hash, the data can be given in several pieces with
+ * display_hash_update() and give the same result than in one piece.
+**/
+typedef struct display_hash_s
+{
+	/** Accumulators of the 4 lanes. **/
+	uint64_t v[4];
+	/** Seed given to display_hash_init(). **/
+	uint64_t seed;
+	/** Total size of the data. **/
+	uint64_t total;
+	/** Data waiting to fill a stripe of 32 bytes. **/
+	uint8_t buffer[32];
+	/** Bytes used in buffer. **/
+	size_t buffered;
+} display_hash_t;
+
+/****************************************************/
+void     display_hash_init(display_hash_t * hash, uint64_t seed);
+void     display_hash_update(display_hash_t * hash, const void * data, size_t size);
+uint64_t display_hash_final(const display_hash_t * hash);
+uint64_t display_hash(const void * data, size_t size, uint64_t seed);
+
+#endif //DISPLAY_HASH_H
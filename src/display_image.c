@@ -0,0 +1,437 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/********************  HEADERS  *********************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "display_image.h"
+
+/********************  CONSTS  **********************/
+
+/** Colors of the gradient, same than 'set palette defined' in the gnuplot scripts. **/
+static const uint8_t display_image_gradient[9][3] = {
+	{0x00, 0x00, 0x90}, {0x00, 0x0f, 0xff}, {0x00, 0x90, 0xff},
+	{0x0f, 0xff, 0xee}, {0x90, 0xff, 0x70}, {0xff, 0xee, 0x00},
+	{0xff, 0x70, 0x00}, {0xee, 0x00, 0x00}, {0x7f, 0x00, 0x00}
+};
+
+/** Size of the hash table of the LZW dictionary, at least twice the 4096 codes. **/
+#define DISPLAY_IMAGE_LZW_HASH 8192
+/** Largest code of the GIF LZW compression (12 bits). **/
+#define DISPLAY_IMAGE_LZW_MAX_CODE 4095
+/** Size of the stored blocks of the PNG zlib stream. **/
+#define DISPLAY_IMAGE_PNG_BLOCK 65535
+
+/*******************  FUNCTION  *********************/
+/**
+ * Fill the RGB values of the palette, the gradient is sampled on the first colors and
+ * the obstacles are white like the background of gnuplot.
+**/
+static void display_image_palette(uint8_t palette[DISPLAY_IMAGE_COLORS][3])
+{
+	int i, k, c;
+	double x, f;
+
+	for (i = 0 ; i < DISPLAY_IMAGE_OBSTACLE ; i++)
+	{
+		x = 8.0 * i / (DISPLAY_IMAGE_OBSTACLE - 1);
+		k = (x >= 8.0) ? 7 : (int)x;
+		f = x - k;
+		for (c = 0 ; c < 3 ; c++)
+			palette[i][c] = (uint8_t)(display_image_gradient[k][c] * (1.0 - f) + display_image_gradient[k + 1][c] * f + 0.5);
+	}
+	palette[DISPLAY_IMAGE_OBSTACLE][0] = 0xff;
+	palette[DISPLAY_IMAGE_OBSTACLE][1] = 0xff;
+	palette[DISPLAY_IMAGE_OBSTACLE][2] = 0xff;
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Integer zoom applied to small meshes to get readable images, the size stays below
+ * 1920x1080 like in gen_animate_gif.sh.
+**/
+int display_image_auto_scale(int mesh_width, int mesh_height)
+{
+	int scale = 1;
+	while (mesh_width * scale < 800 && mesh_width * (scale + 1) <= 1920 && mesh_height * (scale + 1) <= 1080)
+		scale++;
+	return scale;
+}
+
+/*******************  FUNCTION  *********************/
+
+void display_image_init(display_image_t * image, int mesh_width, int mesh_height, int scale)
+{
+	//errors
+	assert(image != NULL);
+	assert(scale > 0);
+
+	//setup
+	image->width = mesh_width * scale;
+	image->height = mesh_height * scale;
+	image->scale = scale;
+	image->pixels = malloc((size_t)image->width * image->height);
+}
+
+/*******************  FUNCTION  *********************/
+
+void display_image_release(display_image_t * image)
+{
+	assert(image != NULL);
+	free(image->pixels);
+	image->pixels = NULL;
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Draw the velocity of a frame (column 4 of the gnuplot output), the entries are stored
+ * by lines of ranks like in print_current_frame_gnuplot().
+**/
+void display_image_render(display_image_t * image, const lbm_file_header_t * header, const lbm_file_entry_t * entries)
+{
+	//vars
+	uint32_t i, j, l, y;
+	int dx, dy, pos, row;
+	uint8_t color;
+	float v;
+	uint32_t line_height = header->mesh_height / header->lines;
+	int scale = image->scale;
+
+	//errors
+	assert(image->width == (int)header->mesh_width * scale);
+	assert(image->height == (int)header->mesh_height * scale);
+
+	//loop on datas
+	for ( i = 0 ; i < header->mesh_width ; i++)
+	{
+		for ( l = 0 ; l < header->lines ; l++)
+		{
+			for ( j = 0 ; j < line_height ; j++)
+			{
+				//color
+				pos = line_height * i + j + l * line_height * header->mesh_width;
+				v = entries[pos].v;
+				if (isnan(v))
+					color = DISPLAY_IMAGE_OBSTACLE;
+				else if (v <= 0.0)
+					color = 0;
+				else if (v >= DISPLAY_IMAGE_MAX_VELOCITY)
+					color = DISPLAY_IMAGE_OBSTACLE - 1;
+				else
+					color = (uint8_t)(v / DISPLAY_IMAGE_MAX_VELOCITY * (DISPLAY_IMAGE_OBSTACLE - 1) + 0.5);
+
+				//draw, Y goes up
+				y = j + l * line_height;
+				row = (header->mesh_height - 1 - y) * scale;
+				for (dy = 0 ; dy < scale ; dy++)
+					for (dx = 0 ; dx < scale ; dx++)
+						image->pixels[(size_t)(row + dy) * image->width + i * scale + dx] = color;
+			}
+		}
+	}
+}
+
+/*******************  FUNCTION  *********************/
+
+static void display_image_write_be32(uint8_t * out, uint32_t value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+
+/*******************  FUNCTION  *********************/
+
+static uint32_t display_image_crc32(const uint32_t table[256], uint32_t crc, const uint8_t * data, size_t size)
+{
+	size_t i;
+	for (i = 0 ; i < size ; i++)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+/*******************  FUNCTION  *********************/
+/** Write a PNG chunk with its length and CRC. **/
+static void display_image_png_chunk(FILE * fp, const uint32_t table[256], const char * type, const uint8_t * data, uint32_t size)
+{
+	uint8_t buffer[4];
+	uint32_t crc;
+
+	display_image_write_be32(buffer, size);
+	fwrite(buffer, 1, 4, fp);
+	fwrite(type, 1, 4, fp);
+	if (size > 0)
+		fwrite(data, 1, size, fp);
+	crc = display_image_crc32(table, 0xffffffff, (const uint8_t*)type, 4);
+	crc = display_image_crc32(table, crc, data, size);
+	display_image_write_be32(buffer, crc ^ 0xffffffff);
+	fwrite(buffer, 1, 4, fp);
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Write the image as an 8 bits indexed PNG. The zlib stream uses stored blocks, the
+ * palette indexes are already a compact representation and it keeps the encoder trivial.
+ * @return 0 on success, -1 if the file cannot be written.
+**/
+int display_image_write_png(const display_image_t * image, const char * filename)
+{
+	//vars
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	uint32_t table[256];
+	uint8_t palette[DISPLAY_IMAGE_COLORS][3];
+	uint8_t ihdr[13];
+	uint32_t c, adler_a = 1, adler_b = 0;
+	size_t raw_size = (size_t)(image->width + 1) * image->height;
+	size_t blocks = (raw_size + DISPLAY_IMAGE_PNG_BLOCK - 1) / DISPLAY_IMAGE_PNG_BLOCK;
+	size_t i, k, block, src, len;
+	int n, y;
+	FILE * fp;
+
+	//crc table
+	for (n = 0 ; n < 256 ; n++) {
+		c = n;
+		for (k = 0 ; k < 8 ; k++)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+
+	//raw data, each line starts with the filter type (none)
+	uint8_t * raw = malloc(raw_size);
+	for (y = 0 ; y < image->height ; y++) {
+		raw[(size_t)y * (image->width + 1)] = 0;
+		memcpy(raw + (size_t)y * (image->width + 1) + 1, image->pixels + (size_t)y * image->width, image->width);
+	}
+
+	//zlib stream with stored blocks
+	size_t zsize = 2 + blocks * 5 + raw_size + 4;
+	uint8_t * zdata = malloc(zsize);
+	i = 0;
+	zdata[i++] = 0x78;
+	zdata[i++] = 0x01;
+	for (block = 0, src = 0 ; block < blocks ; block++, src += len) {
+		len = raw_size - src;
+		if (len > DISPLAY_IMAGE_PNG_BLOCK)
+			len = DISPLAY_IMAGE_PNG_BLOCK;
+		zdata[i++] = (block == blocks - 1) ? 1 : 0;
+		zdata[i++] = len & 0xff;
+		zdata[i++] = len >> 8;
+		zdata[i++] = ~len & 0xff;
+		zdata[i++] = (~len >> 8) & 0xff;
+		memcpy(zdata + i, raw + src, len);
+		i += len;
+	}
+	for (k = 0 ; k < raw_size ; k++) {
+		adler_a = (adler_a + raw[k]) % 65521;
+		adler_b = (adler_b + adler_a) % 65521;
+	}
+	display_image_write_be32(zdata + i, (adler_b << 16) | adler_a);
+	assert(i + 4 == zsize);
+
+	//open
+	fp = fopen(filename, "wb");
+	if (fp == NULL) {
+		perror(filename);
+		free(raw);
+		free(zdata);
+		return -1;
+	}
+
+	//header, 8 bits palette
+	display_image_write_be32(ihdr, image->width);
+	display_image_write_be32(ihdr + 4, image->height);
+	ihdr[8] = 8;
+	ihdr[9] = 3;
+	ihdr[10] = 0;
+	ihdr[11] = 0;
+	ihdr[12] = 0;
+	display_image_palette(palette);
+
+	//chunks
+	fwrite(signature, 1, sizeof(signature), fp);
+	display_image_png_chunk(fp, table, "IHDR", ihdr, sizeof(ihdr));
+	display_image_png_chunk(fp, table, "PLTE", &palette[0][0], sizeof(palette));
+	for (src = 0 ; src < zsize ; src += len) {
+		len = zsize - src;
+		if (len > 0x7fffffff)
+			len = 0x7fffffff;
+		display_image_png_chunk(fp, table, "IDAT", zdata + src, len);
+	}
+	display_image_png_chunk(fp, table, "IEND", NULL, 0);
+
+	//close
+	fclose(fp);
+	free(raw);
+	free(zdata);
+	return 0;
+}
+
+/*******************  STRUCT  ***********************/
+/** Output of the LZW codes, packed from the lowest bits. **/
+typedef struct display_image_bits_s
+{
+	uint8_t * data;
+	size_t size;
+	size_t capacity;
+	uint32_t accumulator;
+	int count;
+} display_image_bits_t;
+
+/*******************  FUNCTION  *********************/
+
+static void display_image_bits_put(display_image_bits_t * bits, int code, int code_size)
+{
+	bits->accumulator |= (uint32_t)code << bits->count;
+	bits->count += code_size;
+	while (bits->count >= 8) {
+		if (bits->size == bits->capacity) {
+			bits->capacity *= 2;
+			bits->data = realloc(bits->data, bits->capacity);
+		}
+		bits->data[bits->size++] = bits->accumulator & 0xff;
+		bits->accumulator >>= 8;
+		bits->count -= 8;
+	}
+}
+
+/*******************  FUNCTION  *********************/
+/**
+ * Compress the pixels of an image with the LZW variant of GIF (8 bits minimum code size).
+ * The frames of an animation can be encoded in parallel and written in order with
+ * display_image_gif_frame().
+ * @param data Filled with a buffer to free containing the codes.
+ * @return Size of data.
+**/
+size_t display_image_gif_encode(const display_image_t * image, uint8_t ** data)
+{
+	//vars
+	const int clear_code = 256;
+	const int eoi_code = 257;
+	int32_t keys[DISPLAY_IMAGE_LZW_HASH];
+	uint16_t codes[DISPLAY_IMAGE_LZW_HASH];
+	size_t i, count = (size_t)image->width * image->height;
+	int code_size = 9, max_code = eoi_code, prefix, slot;
+	int32_t key;
+	display_image_bits_t bits = {malloc(4096), 0, 4096, 0, 0};
+
+	//start with an empty dictionary
+	memset(keys, 0xff, sizeof(keys));
+	display_image_bits_put(&bits, clear_code, code_size);
+
+	//loop on pixels
+	prefix = image->pixels[0];
+	for (i = 1 ; i < count ; i++)
+	{
+		//extend the current string if known
+		key = (prefix << 8) | image->pixels[i];
+		slot = (key * 2654435761u) % DISPLAY_IMAGE_LZW_HASH;
+		while (keys[slot] != -1 && keys[slot] != key)
+			slot = (slot + 1) % DISPLAY_IMAGE_LZW_HASH;
+		if (keys[slot] == key) {
+			prefix = codes[slot];
+			continue;
+		}
+
+		//emit & learn the new string
+		display_image_bits_put(&bits, prefix, code_size);
+		keys[slot] = key;
+		codes[slot] = ++max_code;
+		if (max_code >= (1 << code_size))
+			code_size++;
+
+		//dictionary full, restart
+		if (max_code == DISPLAY_IMAGE_LZW_MAX_CODE) {
+			display_image_bits_put(&bits, clear_code, code_size);
+			memset(keys, 0xff, sizeof(keys));
+			code_size = 9;
+			max_code = eoi_code;
+		}
+		prefix = image->pixels[i];
+	}
+
+	//end
+	display_image_bits_put(&bits, prefix, code_size);
+	display_image_bits_put(&bits, eoi_code, code_size);
+	display_image_bits_put(&bits, 0, 7);
+
+	*data = bits.data;
+	return bits.size;
+}
+
+/*******************  FUNCTION  *********************/
+
+static void display_image_write_le16(FILE * fp, int value)
+{
+	fputc(value & 0xff, fp);
+	fputc((value >> 8) & 0xff, fp);
+}
+
+/*******************  FUNCTION  *********************/
+/** Write the header of an animated GIF looping forever with the palette. **/
+void display_image_gif_begin(FILE * fp, int width, int height)
+{
+	uint8_t palette[DISPLAY_IMAGE_COLORS][3];
+	static const uint8_t loop[19] = {0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00};
+
+	//screen with global palette of 256 colors
+	fwrite("GIF89a", 1, 6, fp);
+	display_image_write_le16(fp, width);
+	display_image_write_le16(fp, height);
+	fputc(0xf7, fp);
+	fputc(0, fp);
+	fputc(0, fp);
+	display_image_palette(palette);
+	fwrite(palette, 1, sizeof(palette), fp);
+
+	//loop
+	fwrite(loop, 1, sizeof(loop), fp);
+}
+
+/*******************  FUNCTION  *********************/
+/** Write a frame encoded by display_image_gif_encode(). **/
+void display_image_gif_frame(FILE * fp, int width, int height, const uint8_t * data, size_t size)
+{
+	size_t i, len;
+
+	//delay
+	fputc(0x21, fp);
+	fputc(0xf9, fp);
+	fputc(4, fp);
+	fputc(0, fp);
+	display_image_write_le16(fp, DISPLAY_IMAGE_GIF_DELAY);
+	fputc(0, fp);
+	fputc(0, fp);
+
+	//image descriptor covering the screen
+	fputc(0x2c, fp);
+	display_image_write_le16(fp, 0);
+	display_image_write_le16(fp, 0);
+	display_image_write_le16(fp, width);
+	display_image_write_le16(fp, height);
+	fputc(0, fp);
+
+	//codes in sub-blocks of 255 bytes
+	fputc(8, fp);
+	for (i = 0 ; i < size ; i += len) {
+		len = (size - i > 255) ? 255 : size - i;
+		fputc(len, fp);
+		fwrite(data + i, 1, len, fp);
+	}
+	fputc(0, fp);
+}
+
+/*******************  FUNCTION  *********************/
+
+void display_image_gif_end(FILE * fp)
+{
+	fputc(0x3b, fp);
+}
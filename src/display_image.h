@@ -0,0 +1,60 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef DISPLAY_IMAGE_H
+#define DISPLAY_IMAGE_H
+
+/****************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "lbm_struct.h"
+
+/****************************************************/
+/** Number of colors of the palette, the last one is used for the obstacles. **/
+#define DISPLAY_IMAGE_COLORS 256
+/** Color index of the obstacle cells (NaN values). **/
+#define DISPLAY_IMAGE_OBSTACLE (DISPLAY_IMAGE_COLORS - 1)
+/** Velocity mapped on the last color of the gradient, same than 'set cbr [0:0.14]' in the gnuplot scripts. **/
+#define DISPLAY_IMAGE_MAX_VELOCITY 0.14
+/** Delay between the frames of the animations in 1/100 s, same than 'set term gif animate delay 5'. **/
+#define DISPLAY_IMAGE_GIF_DELAY 5
+
+/****************************************************/
+/**
+ * Frame rendered with one palette index per pixel, the X axis of the mesh is horizontal
+ * and the Y axis goes up like in the gnuplot maps.
+**/
+typedef struct display_image_s
+{
+	/** Width in pixels. **/
+	int width;
+	/** Height in pixels. **/
+	int height;
+	/** Size of the square of pixels drawn for one cell. **/
+	int scale;
+	/** Palette index of the pixels, line by line from the top. **/
+	uint8_t * pixels;
+} display_image_t;
+
+/****************************************************/
+int  display_image_auto_scale(int mesh_width, int mesh_height);
+void display_image_init(display_image_t * image, int mesh_width, int mesh_height, int scale);
+void display_image_release(display_image_t * image);
+void display_image_render(display_image_t * image, const lbm_file_header_t * header, const lbm_file_entry_t * entries);
+
+/****************************************************/
+int  display_image_write_png(const display_image_t * image, const char * filename);
+
+/****************************************************/
+size_t display_image_gif_encode(const display_image_t * image, uint8_t ** data);
+void display_image_gif_begin(FILE * fp, int width, int height);
+void display_image_gif_frame(FILE * fp, int width, int height, const uint8_t * data, size_t size);
+void display_image_gif_end(FILE * fp);
+
+#endif //DISPLAY_IMAGE_H
@@ -9,6 +9,8 @@
 /****************************************************/
 #include "lbm_struct.h"
 #include "exercises.h"
+#include "lbm_timers.h"
+#include "lbm_balance.h"
 
 /****************************************************/
 static int gblExercice = 0;
@@ -19,7 +21,7 @@ void lbm_ex_select(int id)
 	int rank;
 	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
 	gblExercice = id;
-	if (id < 0 || id > 6)
+	if (id < 0 || id > 7)
 		fatal("Invalid exercice ID !");
 	if (rank == 0)
 		printf("\033[32mSelect exercice %d\033[39m\n", id);
@@ -28,6 +30,10 @@ void lbm_ex_select(int id)
 /****************************************************/
 void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_height )
 {
+	//default communicator, ex7 replace it by a cartesian one
+	comm->communicator = MPI_COMM_WORLD;
+	comm->neighbour_communicator = MPI_COMM_NULL;
+
 	switch (gblExercice) {
 		case 0:
 			lbm_comm_init_ex0(comm, total_width, total_height);
@@ -50,6 +56,9 @@ void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_heig
 		case 6:
 			lbm_comm_init_ex6(comm, total_width, total_height);
 			break;
+		case 7:
+			lbm_comm_init_ex7(comm, total_width, total_height);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -65,16 +74,29 @@ void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_heig
 	if (comm->x == -1 || comm->y == -1)
 		fatal("lbm_comm_init_ex not implemented for this exercise, x or y is -1 !");//, gblExercice);
 
+	//move the cuts between the columns, exercise 0 is sequential
+	if (BALANCE_MODE == LBM_BALANCE_WEIGHTED && gblExercice != 0 && comm->nb_x > 1)
+		lbm_balance_columns( comm, total_width, total_height );
+
 	//check
-	if (total_width % comm->nb_x != 0)
+	if (BALANCE_MODE == LBM_BALANCE_EVEN && total_width % comm->nb_x != 0)
 		warning("nb_x not multiple of total_width !");
 	if (total_height % comm->nb_y != 0)
 		warning("nb_x not multiple of total_width !");
+
+	//deep ghost layers toward the neighboors
+	lbm_comm_init_halo(comm);
+
+	//types to exchange the parts of the mesh
+	lbm_comm_init_mesh_types(comm);
 }
 
 /****************************************************/
 void lbm_comm_release_ex_select( lbm_comm_t * comm )
 {
+	//types to exchange the parts of the mesh
+	lbm_comm_release_mesh_types(comm);
+
 	switch(gblExercice) {
 		case 0:
 			lbm_comm_release_ex0(comm);
@@ -97,6 +119,9 @@ void lbm_comm_release_ex_select( lbm_comm_t * comm )
 		case 6:
 			lbm_comm_release_ex6(comm);
 			break;
+		case 7:
+			lbm_comm_release_ex7(comm);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -106,6 +131,26 @@ void lbm_comm_release_ex_select( lbm_comm_t * comm )
 /****************************************************/
 void lbm_comm_ghost_exchange_ex_select(lbm_comm_t * comm, lbm_mesh_t * mesh )
 {
+	//vars
+	double timer;
+
+	//deep halos, each step computes one layer less of valid ghost cells, the ones received
+	//by the last exchange are enough for HALO_DEPTH steps
+	if (comm->halo_steps > 0) {
+		comm->halo_steps--;
+		return;
+	}
+	comm->halo_steps = comm->halo - 1;
+	timer = lbm_timer_start();
+
+	//generic exchange with persistent requests, same result than the exercises
+	if (EXCHANGE_MODE != LBM_EXCHANGE_EXERCISE) {
+		lbm_comm_ghost_exchange_start(comm, mesh);
+		lbm_comm_ghost_exchange_wait(comm);
+		lbm_timer_stop(LBM_TIMER_EXCHANGE, timer);
+		return;
+	}
+
 	switch(gblExercice) {
 		case 0:
 			lbm_comm_ghost_exchange_ex0(comm, mesh);
@@ -128,15 +173,24 @@ void lbm_comm_ghost_exchange_ex_select(lbm_comm_t * comm, lbm_mesh_t * mesh )
 		case 6:
 			lbm_comm_ghost_exchange_ex6(comm, mesh);
 			break;
+		case 7:
+			lbm_comm_ghost_exchange_ex7(comm, mesh);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
 	}
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_EXCHANGE, timer);
 }
 
 /****************************************************/
 void lbm_save_ex_select(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_mesh_t * mesh_to_save, lbm_mesh_type_t * mesh_type, int write_step)
 {
+	//vars
+	double timer = lbm_timer_start();
+
 	switch(gblExercice) {
 		case 0:
 			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
@@ -159,15 +213,113 @@ void lbm_save_ex_select(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_me
 		case 6:
 			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
 			break;
+		case 7:
+			lbm_save_ex0(save_buffer, comm, mesh_to_save, mesh_type, write_step);
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
 	}
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_SAVE, timer);
+}
+
+/****************************************************/
+/**
+ * Step implementation doing special cells, collision and propagation in a single pass
+ * over the mesh. The ghost cells are exchanged before the pass and the result is produced
+ * into temp_mesh which is then swapped with mesh.
+**/
+void lbm_do_step_fused(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh )
+{
+	//get ghost cells before applying the local operations on them
+	lbm_comm_ghost_exchange_ex_select( comm, mesh );
+
+	//compute special actions, collision and propagation
+	lbm_phys_collide_and_stream( temp_mesh, mesh, mesh_type, comm );
+
+	//result is now in temp_mesh
+	lbm_mesh_swap( mesh, temp_mesh );
+}
+
+/****************************************************/
+/**
+ * Step implementation using the in place AA streaming, only one mesh is needed. The
+ * steps alternate between lbm_phys_aa_even_step() and lbm_phys_aa_odd_step(), the state
+ * is tracked by mesh->aa_swapped.
+**/
+void lbm_do_step_aa(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh )
+{
+	if (mesh->aa_swapped == 0) {
+		//natural state, the ghost cells can be exchanged with the selected exercise
+		lbm_comm_ghost_exchange_ex_select( comm, mesh );
+		lbm_phys_aa_even_step( mesh, mesh_type, comm );
+	} else {
+		//the values entering our ghost cells are two cells away in the neighboors
+		double timer = lbm_timer_start();
+		lbm_comm_aa_halo_exchange( comm, mesh );
+		lbm_timer_stop(LBM_TIMER_EXCHANGE, timer);
+		lbm_phys_aa_odd_step( mesh, mesh_type, comm );
+	}
+}
+
+/****************************************************/
+/**
+ * Step implementation overlapping the ghost cells exchange with the computation. The
+ * border (ghost cells and the first layer of real cells sent to the neighboors) is
+ * computed first, then the exchange is started while the inner cells are computed, the
+ * propagation from the received ghost cells is done at the end. It uses a generic
+ * non-blocking exchange working for the 1D and 2D splittings of the exercises.
+**/
+void lbm_do_step_overlap(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh )
+{
+	//vars
+	double timer;
+
+	//border cells, the values to send
+	lbm_phys_special_cells_border( mesh, mesh_type, comm, 2 );
+	lbm_phys_collision_border( temp_mesh, mesh, 2 );
+
+	//start exchange
+	timer = lbm_timer_start();
+	lbm_comm_ghost_exchange_start( comm, temp_mesh );
+	lbm_timer_stop(LBM_TIMER_EXCHANGE, timer);
+
+	//inner cells while the messages fly, poke MPI between the phases to make it progress
+	lbm_phys_special_cells_inner( mesh, mesh_type, comm, 2 );
+	lbm_comm_ghost_exchange_test( comm );
+	lbm_phys_collision_inner( temp_mesh, mesh, 2 );
+	lbm_comm_ghost_exchange_test( comm );
+	lbm_phys_propagation_inner( mesh, temp_mesh, 1 );
+
+	//wait ghost cells
+	timer = lbm_timer_start();
+	lbm_comm_ghost_exchange_wait( comm );
+	lbm_timer_stop(LBM_TIMER_EXCHANGE, timer);
+
+	//propagate from the ghost cells
+	lbm_phys_propagation_border( mesh, temp_mesh, 1 );
 }
 
 /****************************************************/
 void lbm_do_step_ex_select(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh )
 {
+	//alternative step implementations
+	switch(STEP_MODE) {
+		case LBM_STEP_CLASSIC:
+			break;
+		case LBM_STEP_FUSED:
+			lbm_do_step_fused(comm, mesh_type, mesh, temp_mesh );
+			return;
+		case LBM_STEP_AA:
+			lbm_do_step_aa(comm, mesh_type, mesh );
+			return;
+		case LBM_STEP_OVERLAP:
+			lbm_do_step_overlap(comm, mesh_type, mesh, temp_mesh );
+			return;
+	}
+
 	switch(gblExercice) {
 		case 0:
 			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
@@ -190,6 +342,9 @@ void lbm_do_step_ex_select(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_m
 		case 6:
 			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
 			break;
+		case 7:
+			lbm_do_step_ex0(comm, mesh_type, mesh, temp_mesh );
+			break;
 		default:
 			fatal("Invalid exercice number !");
 			break;
@@ -203,5 +358,5 @@ void lbm_save_ex0(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_mesh_t *
 	lbm_save_fill_mesh(save_buffer, mesh_to_save, mesh_type);
 
 	//write to file
-	lbm_save_write_mesh(save_buffer, comm, comm->rank_x, comm->rank_y, write_step);
+	lbm_save_write_mesh(save_buffer, comm, write_step);
 }
@@ -72,6 +72,18 @@ void lbm_comm_ghost_exchange_ex6(lbm_comm_t * comm, lbm_mesh_t * mesh );
 void lbm_save_ex6(lbm_file_mesh_t * save_buffer, lbm_comm_t * comm, lbm_mesh_t * mesh_to_save, lbm_mesh_type_t * mesh_type, int write_step);
 void lbm_do_step_ex6(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
 
+/****************************************************/
+//2D + cartesian topology & neighborhood collectives
+void lbm_comm_init_ex7( lbm_comm_t * comm, int total_width, int total_height );
+void lbm_comm_release_ex7( lbm_comm_t * comm );
+void lbm_comm_ghost_exchange_ex7(lbm_comm_t * comm, lbm_mesh_t * mesh );
+
+/****************************************************/
+//step implementations independent of the communication scheme
+void lbm_do_step_fused(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+void lbm_do_step_aa(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh );
+void lbm_do_step_overlap(lbm_comm_t * comm, lbm_mesh_type_t * mesh_type, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh );
+
 /****************************************************/
 //select
 void lbm_comm_init_ex_select( lbm_comm_t * comm, int total_width, int total_height );
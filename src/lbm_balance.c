@@ -0,0 +1,263 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lbm_balance.h"
+#include "lbm_init.h"
+#include "lbm_timers.h"
+#include "exercises.h"
+
+/****************************************************/
+/**
+ * Déplace les coupes entre les colonnes de processus pour équilibrer le coût des mailles
+ * (BALANCE_MODE = LBM_BALANCE_WEIGHTED). Les coupes entre les lignes ne bougent pas, le
+ * fichier de sortie suppose des lignes de même hauteur. Toutes les lignes de processus
+ * ont les mêmes coupes, les voisins restent alignés.
+**/
+void lbm_balance_columns( lbm_comm_t * comm, int total_width, int total_height )
+{
+	//vars
+	int p, rank;
+	int * cuts = malloc( (comm->nb_x + 1) * sizeof(int) );
+	double * costs = malloc( total_width * sizeof(double) );
+	double even_max = 0.0, weighted_max = 0.0, cost, total = 0.0;
+
+	//cost of the columns & cuts
+	lbm_init_column_costs( costs, total_width, total_height );
+	lbm_comm_weighted_cuts( costs, total_width, comm->nb_x, cuts );
+
+	//apply
+	comm->x = cuts[comm->rank_x];
+	comm->width = cuts[comm->rank_x + 1] - cuts[comm->rank_x] + 2;
+
+	//report the most loaded column of ranks compared to the even splitting
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	if (rank == RANK_MASTER)
+	{
+		for ( p = 0 ; p < total_width ; p++ )
+			total += costs[p];
+		for ( p = 0 ; p < comm->nb_x ; p++ )
+		{
+			int first = total_width / comm->nb_x * p;
+			int last = (p == comm->nb_x - 1) ? total_width : first + total_width / comm->nb_x;
+			for ( cost = 0.0 ; first < last ; first++ )
+				cost += costs[first];
+			if (cost > even_max)
+				even_max = cost;
+			for ( cost = 0.0, first = cuts[p] ; first < cuts[p + 1] ; first++ )
+				cost += costs[first];
+			if (cost > weighted_max)
+				weighted_max = cost;
+		}
+		printf("\033[32mWeighted splitting along X, imbalance (max/avg) %.3f -> %.3f\033[39m\n",
+			even_max * comm->nb_x / total, weighted_max * comm->nb_x / total);
+	}
+
+	//free
+	free(cuts);
+	free(costs);
+}
+
+/****************************************************/
+/** Première colonne globale (mailles fantômes globales comprises) possédée par la colonne de processus p. **/
+static inline int lbm_balance_first( const int * cuts, int p )
+{
+	return (p == 0) ? 0 : cuts[p] + 1;
+}
+
+/****************************************************/
+/** Fin (exclue) des colonnes globales possédées par la colonne de processus p parmi parts. **/
+static inline int lbm_balance_end( const int * cuts, int p, int parts )
+{
+	return (p == parts - 1) ? cuts[parts] + 2 : cuts[p + 1] + 1;
+}
+
+/****************************************************/
+/**
+ * Type MPI décrivant count colonnes consécutives du maillage (toutes les directions),
+ * les colonnes sont contigües dans chaque plan de direction avec LBM_LAYOUT_SOA.
+**/
+static void lbm_balance_columns_type( const lbm_mesh_t * mesh, int count, MPI_Datatype * type )
+{
+	if (mesh->direction_stride == 1)
+		MPI_Type_contiguous( count * mesh->height * DIRECTIONS, MPI_DOUBLE, type );
+	else
+		MPI_Type_vector( DIRECTIONS, count * mesh->height, mesh->direction_stride, MPI_DOUBLE, type );
+	MPI_Type_commit( type );
+}
+
+/****************************************************/
+/**
+ * Déplace les colonnes du maillage entre les processus d'une même ligne pour passer
+ * des coupes old_cuts aux coupes new_cuts. Le maillage est réalloué à sa nouvelle largeur,
+ * les mailles fantômes ne sont pas remplies.
+**/
+static void lbm_balance_migrate_mesh( lbm_comm_t * comm, lbm_mesh_t * mesh, const int * old_cuts, const int * new_cuts )
+{
+	//vars
+	int q, first, last, rank;
+	int count = 0;
+	const int me = comm->rank_x;
+	const int parts = comm->nb_x;
+	MPI_Request * requests = malloc( 2 * parts * sizeof(MPI_Request) );
+	MPI_Datatype type;
+	lbm_mesh_t fresh;
+
+	//errors
+	assert(requests != NULL);
+	assert(mesh->aa_swapped == 0);
+
+	//new mesh
+	lbm_mesh_init( &fresh, new_cuts[me + 1] - new_cuts[me] + 2, mesh->height );
+
+	//exchange the overlaps of the old and new ranges with every rank of the line, ourself included
+	for ( q = 0 ; q < parts ; q++ )
+	{
+		rank = lbm_comm_neighbour_rank( comm, q - me, 0 );
+
+		//what we get from q
+		first = lbm_balance_first(new_cuts, me) > lbm_balance_first(old_cuts, q) ? lbm_balance_first(new_cuts, me) : lbm_balance_first(old_cuts, q);
+		last = lbm_balance_end(new_cuts, me, parts) < lbm_balance_end(old_cuts, q, parts) ? lbm_balance_end(new_cuts, me, parts) : lbm_balance_end(old_cuts, q, parts);
+		if (first < last)
+		{
+			lbm_balance_columns_type( &fresh, last - first, &type );
+			MPI_Irecv( lbm_mesh_get_cell(&fresh, first - new_cuts[me], 0), 1, type, rank, 0, comm->communicator, &requests[count++] );
+			MPI_Type_free( &type );
+		}
+
+		//what we give to q
+		first = lbm_balance_first(old_cuts, me) > lbm_balance_first(new_cuts, q) ? lbm_balance_first(old_cuts, me) : lbm_balance_first(new_cuts, q);
+		last = lbm_balance_end(old_cuts, me, parts) < lbm_balance_end(new_cuts, q, parts) ? lbm_balance_end(old_cuts, me, parts) : lbm_balance_end(new_cuts, q, parts);
+		if (first < last)
+		{
+			lbm_balance_columns_type( mesh, last - first, &type );
+			MPI_Isend( lbm_mesh_get_cell(mesh, first - old_cuts[me], 0), 1, type, rank, 0, comm->communicator, &requests[count++] );
+			MPI_Type_free( &type );
+		}
+	}
+	MPI_Waitall( count, requests, MPI_STATUSES_IGNORE );
+
+	//replace
+	lbm_mesh_release( mesh );
+	*mesh = fresh;
+	free(requests);
+}
+
+/****************************************************/
+/**
+ * Rééquilibrage pendant le calcul : tous les REBALANCE_INTERVAL pas, compare le temps de
+ * calcul des colonnes de processus depuis le dernier contrôle. Si le rapport max/moyenne
+ * dépasse REBALANCE_THRESHOLD les coupes sont replacées en supposant un coût uniforme des
+ * mailles de chaque colonne de processus (le temps mesuré divisé par sa largeur), puis les
+ * colonnes de mailles sont migrées entre les processus de chaque ligne. Les tailles et
+ * positions de comm, les types MPI, les types des mailles et le tampon de sortie suivent.
+ * Avec le pas aa le rééquilibrage n'a lieu que dans l'état naturel du maillage.
+ * @param temp_mesh Second maillage, ignoré si non alloué (pas aa).
+ * @return Vrai si le découpage a changé.
+**/
+int lbm_balance_runtime( lbm_comm_t * comm, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh, lbm_mesh_type_t * mesh_type, lbm_file_mesh_t * save_mesh, int step )
+{
+	//vars
+	static double last_time = 0.0;
+	int p, i, rank, changed;
+	const int parts = comm->nb_x;
+	double time, delta, max = 0.0, sum = 0.0;
+	double * times;
+	double * costs;
+	int * old_cuts;
+	int * new_cuts;
+
+	//nothing to do
+	if (REBALANCE_INTERVAL <= 0 || step % REBALANCE_INTERVAL != 0 || parts == 1 || mesh->aa_swapped)
+		return 0;
+
+	//compute time since the last check
+	time = lbm_gbl_timers[LBM_TIMER_SPECIAL_CELLS] + lbm_gbl_timers[LBM_TIMER_COLLISION]
+	     + lbm_gbl_timers[LBM_TIMER_PROPAGATION] + lbm_gbl_timers[LBM_TIMER_COLLIDE_STREAM];
+	delta = time - last_time;
+	last_time = time;
+
+	//slowest rank of each column of ranks and current cuts
+	times = calloc( parts, sizeof(double) );
+	old_cuts = calloc( parts + 1, sizeof(int) );
+	new_cuts = malloc( (parts + 1) * sizeof(int) );
+	costs = malloc( MESH_WIDTH * sizeof(double) );
+	times[comm->rank_x] = delta;
+	old_cuts[comm->rank_x] = comm->x;
+	MPI_Allreduce( MPI_IN_PLACE, times, parts, MPI_DOUBLE, MPI_MAX, comm->communicator );
+	MPI_Allreduce( MPI_IN_PLACE, old_cuts, parts, MPI_INT, MPI_MAX, comm->communicator );
+	old_cuts[parts] = MESH_WIDTH;
+
+	//check imbalance, all the ranks take the same decision
+	for ( p = 0 ; p < parts ; p++ )
+	{
+		sum += times[p];
+		if (times[p] > max)
+			max = times[p];
+	}
+	changed = (sum > 0.0 && max * parts / sum > REBALANCE_THRESHOLD);
+
+	//new cuts
+	if (changed)
+	{
+		for ( p = 0 ; p < parts ; p++ )
+			for ( i = old_cuts[p] ; i < old_cuts[p + 1] ; i++ )
+				costs[i] = times[p] / (old_cuts[p + 1] - old_cuts[p]);
+		lbm_comm_weighted_cuts( costs, MESH_WIDTH, parts, new_cuts );
+		changed = 0;
+		for ( p = 0 ; p < parts ; p++ )
+			if (new_cuts[p] != old_cuts[p])
+				changed = 1;
+	}
+
+	//migrate
+	if (changed)
+	{
+		MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+		if (rank == RANK_MASTER)
+		{
+			printf("\033[33mRebalance at step %d, imbalance (max/avg) %.3f, cuts :", step, max * parts / sum);
+			for ( p = 1 ; p < parts ; p++ )
+				printf(" %d -> %d", old_cuts[p], new_cuts[p]);
+			printf("\033[39m\n");
+		}
+
+		//cells
+		lbm_balance_migrate_mesh( comm, mesh, old_cuts, new_cuts );
+		if (temp_mesh->cells != NULL)
+			lbm_balance_migrate_mesh( comm, temp_mesh, old_cuts, new_cuts );
+
+		//splitting
+		comm->x = new_cuts[comm->rank_x];
+		comm->width = new_cuts[comm->rank_x + 1] - new_cuts[comm->rank_x] + 2;
+		lbm_comm_release_mesh_types( comm );
+		lbm_comm_init_mesh_types( comm );
+
+		//cell types and output buffer follow the new size
+		lbm_mesh_type_t_release( mesh_type );
+		lbm_mesh_type_t_init( mesh_type, comm->width, comm->height );
+		lbm_init_cell_types( mesh_type, comm );
+		lbm_save_mesh_release( save_mesh );
+		lbm_save_mesh_init( save_mesh, comm );
+
+		//refill the ghost cells
+		lbm_comm_ghost_exchange_ex_select( comm, mesh );
+		if (temp_mesh->cells != NULL)
+			lbm_comm_ghost_exchange_ex_select( comm, temp_mesh );
+	}
+
+	//free
+	free(times);
+	free(costs);
+	free(old_cuts);
+	free(new_cuts);
+	return changed;
+}
@@ -0,0 +1,22 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_BALANCE_H
+#define LBM_BALANCE_H
+
+/****************************************************/
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+#include "lbm_save.h"
+
+/****************************************************/
+void lbm_balance_columns( lbm_comm_t * comm, int total_width, int total_height );
+int  lbm_balance_runtime( lbm_comm_t * comm, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh, lbm_mesh_type_t * mesh_type, lbm_file_mesh_t * save_mesh, int step );
+
+#endif //LBM_BALANCE_H
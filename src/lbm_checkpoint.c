@@ -0,0 +1,236 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "lbm_config.h"
+#include "lbm_checkpoint.h"
+
+/****************************************************/
+/** Accumulate size bytes into a FNV-1a hash. **/
+static uint64_t lbm_checkpoint_hash_bytes(uint64_t hash, const void * data, size_t size)
+{
+	const unsigned char * bytes = data;
+	size_t i;
+	for (i = 0 ; i < size ; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/****************************************************/
+/**
+ * Hash of the parameters defining the problem (mesh, obstacle & flow), a checkpoint can
+ * only be loaded by a run solving the same problem. The implementation options (step,
+ * layout, exchange, splitting...) and the number of iterations can change.
+**/
+uint64_t lbm_checkpoint_config_hash(void)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.width, sizeof(lbm_gbl_config.width));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.height, sizeof(lbm_gbl_config.height));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.obstacle_r, sizeof(lbm_gbl_config.obstacle_r));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.obstacle_x, sizeof(lbm_gbl_config.obstacle_x));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.obstacle_y, sizeof(lbm_gbl_config.obstacle_y));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.inflow_max_velocity, sizeof(lbm_gbl_config.inflow_max_velocity));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.reynolds, sizeof(lbm_gbl_config.reynolds));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.kinetic_viscosity, sizeof(lbm_gbl_config.kinetic_viscosity));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.relax_parameter, sizeof(lbm_gbl_config.relax_parameter));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.obstable_scale, sizeof(lbm_gbl_config.obstable_scale));
+	hash = lbm_checkpoint_hash_bytes(hash, &lbm_gbl_config.obstable_rotate, sizeof(lbm_gbl_config.obstable_rotate));
+	if (lbm_gbl_config.obstacle_filename != NULL)
+		hash = lbm_checkpoint_hash_bytes(hash, lbm_gbl_config.obstacle_filename, strlen(lbm_gbl_config.obstacle_filename));
+	return hash;
+}
+
+/****************************************************/
+/**
+ * Build the types to access a block of local cells in a mesh of the checkpoint file.
+ * @param cell_type Filled with the type of one cell (DIRECTIONS contiguous doubles).
+ * @param file_type Filled with the block of width x height cells starting at (x,y) in the
+ * global mesh with its boundary layers.
+**/
+static void lbm_checkpoint_types(MPI_Datatype * cell_type, MPI_Datatype * file_type, int x, int y, int width, int height)
+{
+	int sizes[2] = {MESH_WIDTH + 2, MESH_HEIGHT + 2};
+	int subsizes[2] = {width, height};
+	int starts[2] = {x, y};
+	MPI_Type_contiguous( DIRECTIONS, MPI_DOUBLE, cell_type );
+	MPI_Type_commit( cell_type );
+	MPI_Type_create_subarray( 2, sizes, subsizes, starts, MPI_ORDER_C, *cell_type, file_type );
+	MPI_Type_commit( file_type );
+}
+
+/****************************************************/
+/**
+ * Write the populations of the meshes into a checkpoint file. Each rank writes its real
+ * cells and the boundary layers of the global mesh it holds, the ghost cells between the
+ * ranks are written by their owner. The file is first written under FILENAME.tmp and
+ * renamed at the end so a run killed during the write keeps the previous checkpoint.
+ * @param filename Name of the checkpoint file.
+ * @param comm Splitting of the mesh.
+ * @param mesh Current mesh, with the aa step it must be after an even step (aa_swapped == 0)
+ * since the values stored in the aa halo are not saved.
+ * @param temp_mesh Temporary mesh of the step, ignored if not allocated (aa step).
+ * @param iteration Last iteration done.
+**/
+void lbm_checkpoint_write(const char * filename, lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_t * temp_mesh, int iteration)
+{
+	//vars
+	int rank, i, j, m, status;
+	char * tmp_filename;
+	MPI_File fh;
+	MPI_Datatype cell_type, file_type;
+	lbm_checkpoint_header_t header;
+	const lbm_mesh_t * meshes[2] = {mesh, temp_mesh};
+
+	//checks
+	assert(filename != NULL);
+	assert(comm != NULL);
+	assert(mesh != NULL);
+	assert(mesh->aa_swapped == 0);
+
+	//cells written by the local rank, the real ones and the boundary layers on the border of the global mesh
+	int x0 = (comm->rank_x == 0) ? 0 : lbm_comm_ghost_left(comm);
+	int x1 = (comm->rank_x == comm->nb_x - 1) ? comm->width : comm->width - lbm_comm_ghost_right(comm);
+	int y0 = (comm->rank_y == 0) ? 0 : lbm_comm_ghost_top(comm);
+	int y1 = (comm->rank_y == comm->nb_y - 1) ? comm->height : comm->height - lbm_comm_ghost_bottom(comm);
+	int count = (x1 - x0) * (y1 - y0);
+	double * buffer = malloc( sizeof(double) * DIRECTIONS * count );
+
+	//header
+	memset(&header, 0, sizeof(header));
+	header.magick = LBM_CHECKPOINT_MAGICK;
+	header.mesh_width = MESH_WIDTH;
+	header.mesh_height = MESH_HEIGHT;
+	header.meshes = (temp_mesh != NULL && temp_mesh->cells != NULL) ? 2 : 1;
+	header.aa_swapped = mesh->aa_swapped;
+	header.config_hash = lbm_checkpoint_config_hash();
+	header.iteration = iteration;
+
+	//open
+	tmp_filename = malloc(strlen(filename) + 5);
+	sprintf(tmp_filename, "%s.tmp", filename);
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	status = MPI_File_open(MPI_COMM_WORLD, tmp_filename, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to open the checkpoint file !");
+	if (rank == RANK_MASTER && MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+		fatal("Fail to write the checkpoint header !");
+
+	//view, the subarray tiles the file mesh by mesh
+	lbm_checkpoint_types( &cell_type, &file_type, lbm_comm_origin_x(comm) + x0, lbm_comm_origin_y(comm) + y0, x1 - x0, y1 - y0 );
+	MPI_File_set_view(fh, sizeof(header), cell_type, file_type, "native", MPI_INFO_NULL);
+
+	//meshes
+	for (m = 0 ; m < (int)header.meshes ; m++)
+	{
+		//pack, whatever the layout is
+		for (i = x0 ; i < x1 ; i++)
+			for (j = y0 ; j < y1 ; j++)
+				lbm_mesh_load_cell(meshes[m], i, j, &buffer[ ((i - x0) * (y1 - y0) + j - y0) * DIRECTIONS ]);
+
+		//write
+		status = MPI_File_write_at_all(fh, (MPI_Offset)count * m, buffer, count, cell_type, MPI_STATUS_IGNORE);
+		if (status != MPI_SUCCESS)
+			fatal("Fail to write the checkpoint file !");
+	}
+
+	//close & replace the previous checkpoint
+	MPI_File_close(&fh);
+	if (rank == RANK_MASTER && rename(tmp_filename, filename) != 0)
+		fatal("Fail to rename the checkpoint file !");
+	MPI_Barrier(MPI_COMM_WORLD);
+
+	//free
+	MPI_Type_free(&file_type);
+	MPI_Type_free(&cell_type);
+	free(tmp_filename);
+	free(buffer);
+}
+
+/****************************************************/
+/**
+ * Load the populations of the meshes from a checkpoint file. Each rank reads all its
+ * local cells, ghost cells included, so the splitting can differ from the one of the
+ * run which wrote the checkpoint.
+ * @param filename Name of the checkpoint file.
+ * @param comm Splitting of the mesh.
+ * @param mesh Current mesh.
+ * @param temp_mesh Temporary mesh of the step, ignored if not allocated (aa step). It keeps
+ * its initial state if the checkpoint does not contain it.
+ * @return Last iteration done before writing the checkpoint.
+**/
+int lbm_checkpoint_read(const char * filename, lbm_comm_t * comm, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh)
+{
+	//vars
+	int i, j, m, meshes, status;
+	MPI_File fh;
+	MPI_Datatype cell_type, file_type;
+	lbm_checkpoint_header_t header;
+	lbm_mesh_t * targets[2] = {mesh, temp_mesh};
+	int count = comm->width * comm->height;
+	double * buffer = malloc( sizeof(double) * DIRECTIONS * count );
+
+	//checks
+	assert(filename != NULL);
+	assert(comm != NULL);
+	assert(mesh != NULL);
+
+	//open
+	status = MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+	if (status != MPI_SUCCESS)
+		fatal("Fail to open the checkpoint file !");
+
+	//header
+	if (MPI_File_read_at_all(fh, 0, &header, sizeof(header), MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+		fatal("Fail to read the checkpoint header !");
+	if (header.magick != LBM_CHECKPOINT_MAGICK)
+		fatal("Invalid checkpoint file !");
+	if (header.mesh_width != MESH_WIDTH || header.mesh_height != MESH_HEIGHT)
+		fatal("The checkpoint has not been written for this mesh size !");
+	if (header.config_hash != lbm_checkpoint_config_hash())
+		fatal("The checkpoint has been written for another problem (config hash mismatch) !");
+	if (header.aa_swapped && STEP_MODE != LBM_STEP_AA)
+		fatal("The checkpoint has been written in the middle of two aa steps, restart it with step_mode = aa !");
+
+	//view of the local mesh, ghost cells included
+	lbm_checkpoint_types( &cell_type, &file_type, lbm_comm_origin_x(comm), lbm_comm_origin_y(comm), comm->width, comm->height );
+	MPI_File_set_view(fh, sizeof(header), cell_type, file_type, "native", MPI_INFO_NULL);
+
+	//meshes
+	meshes = (temp_mesh != NULL && temp_mesh->cells != NULL) ? 2 : 1;
+	if (meshes > (int)header.meshes)
+		meshes = header.meshes;
+	for (m = 0 ; m < meshes ; m++)
+	{
+		//read
+		status = MPI_File_read_at_all(fh, (MPI_Offset)count * m, buffer, count, cell_type, MPI_STATUS_IGNORE);
+		if (status != MPI_SUCCESS)
+			fatal("Fail to read the checkpoint file !");
+
+		//unpack, whatever the layout is
+		for (i = 0 ; i < comm->width ; i++)
+			for (j = 0 ; j < comm->height ; j++)
+				lbm_mesh_store_cell(targets[m], i, j, &buffer[ (i * comm->height + j) * DIRECTIONS ]);
+	}
+	mesh->aa_swapped = header.aa_swapped;
+
+	//free
+	MPI_File_close(&fh);
+	MPI_Type_free(&file_type);
+	MPI_Type_free(&cell_type);
+	free(buffer);
+
+	return header.iteration;
+}
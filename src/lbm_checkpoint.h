@@ -0,0 +1,54 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_CHECKPOINT_H
+#define LBM_CHECKPOINT_H
+
+/****************************************************/
+#include <stdint.h>
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+
+/****************************************************/
+/** Magick number of the checkpoint files. **/
+#define LBM_CHECKPOINT_MAGICK 0x4c424d43
+
+/****************************************************/
+/**
+ * Header of the checkpoint files. It is followed by the populations of the meshes, each
+ * one stored as the global mesh with its boundary layers ((MESH_WIDTH + 2) x
+ * (MESH_HEIGHT + 2) cells, column by column, the DIRECTIONS values of a cell contiguous)
+ * so a run can restart with another splitting or memory layout.
+**/
+typedef struct lbm_checkpoint_header_s
+{
+	/** Magick number to check the type of file. **/
+	uint32_t magick;
+	/** Width of the global mesh (no ghost cells). **/
+	uint32_t mesh_width;
+	/** Height of the global mesh (no ghost cells). **/
+	uint32_t mesh_height;
+	/** Number of meshes stored, the current one and the temporary one if the step uses it. **/
+	uint32_t meshes;
+	/** State of the in place AA streaming (lbm_mesh_t::aa_swapped). **/
+	uint32_t aa_swapped;
+	/** Keep the next fields aligned. **/
+	uint32_t padding;
+	/** Hash of the parameters of the problem, see lbm_checkpoint_config_hash(). **/
+	uint64_t config_hash;
+	/** Last iteration done before writing the checkpoint. **/
+	uint64_t iteration;
+} lbm_checkpoint_header_t;
+
+/****************************************************/
+uint64_t lbm_checkpoint_config_hash(void);
+void lbm_checkpoint_write(const char * filename, lbm_comm_t * comm, const lbm_mesh_t * mesh, const lbm_mesh_t * temp_mesh, int iteration);
+int  lbm_checkpoint_read(const char * filename, lbm_comm_t * comm, lbm_mesh_t * mesh, lbm_mesh_t * temp_mesh);
+
+#endif //LBM_CHECKPOINT_H
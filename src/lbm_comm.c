@@ -12,8 +12,10 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "lbm_comm.h"
+#include "lbm_phys.h"
 
 #define XID 1
 #define YID 0
@@ -35,6 +37,112 @@ int lbm_helper_pgcd(int a, int b)
 	return a;
 }
 
+/****************************************************/
+/**
+ * Nombre de mailles fantômes reçues à chaque pas par l'ensemble des processus pour
+ * une grille de nb_x par nb_y processus : deux fois chaque coupe plus les coins.
+**/
+long lbm_comm_halo_cells( int nb_x, int nb_y, int total_width, int total_height )
+{
+	return 2L * ((long)(nb_x - 1) * total_height + (long)(nb_y - 1) * total_width)
+	     + 4L * (nb_x - 1) * (nb_y - 1);
+}
+
+/****************************************************/
+/**
+ * Choisit la grille de processus nb_x par nb_y qui minimise le volume des mailles
+ * fantômes (la longueur des coupes) pour le maillage global. MPI_Dims_create() donne
+ * la grille la plus carrée possible sans tenir compte de la forme du maillage, ce qui
+ * est mauvais pour un canal allongé (400x80). Toutes les factorisations de comm_size
+ * sont testées, celles laissant moins de 2 mailles réelles par processus sur un axe
+ * ne sont gardées que s'il n'y en a pas d'autre.
+ * @param comm_size Nombre de processus.
+ * @param nb_x Reçoit le nombre de processus selon X.
+ * @param nb_y Reçoit le nombre de processus selon Y.
+**/
+void lbm_comm_plan_grid( int comm_size, int total_width, int total_height, int * nb_x, int * nb_y )
+{
+	//vars
+	int x, y, valid;
+	int best_valid = -1;
+	long cost, best_cost = 0;
+
+	//errors
+	assert(comm_size > 0);
+
+	//loop on divisors, more ranks along X first for the ties
+	for ( x = comm_size ; x >= 1 ; x-- )
+	{
+		if (comm_size % x != 0)
+			continue;
+		y = comm_size / x;
+		valid = (total_width / x >= 2 && total_height / y >= 2);
+		cost = lbm_comm_halo_cells(x, y, total_width, total_height);
+		if (valid > best_valid || (valid == best_valid && cost < best_cost))
+		{
+			best_valid = valid;
+			best_cost = cost;
+			*nb_x = x;
+			*nb_y = y;
+		}
+	}
+}
+
+/****************************************************/
+/**
+ * Place les coupes entre count colonnes pondérées pour que chacune des parts ait le même
+ * coût, chaque coupe est placée au plus proche de sa cible sur la somme cumulée des coûts
+ * en laissant au moins 2 colonnes par part.
+ * @param costs Coût de chacune des count colonnes.
+ * @param cuts Reçoit parts + 1 positions, la part p contient les colonnes [cuts[p], cuts[p+1]).
+**/
+void lbm_comm_weighted_cuts( const double * costs, int count, int parts, int * cuts )
+{
+	//vars
+	int i, p, c, min, max;
+	double target;
+	double * prefix = malloc( (count + 1) * sizeof(double) );
+
+	//errors
+	assert(prefix != NULL);
+	assert(count >= 2 * parts);
+
+	//cumulated cost
+	prefix[0] = 0.0;
+	for ( i = 0 ; i < count ; i++ )
+		prefix[i + 1] = prefix[i] + costs[i];
+
+	//cuts
+	cuts[0] = 0;
+	cuts[parts] = count;
+	for ( p = 1 ; p < parts ; p++ )
+	{
+		target = prefix[count] * p / parts;
+		min = cuts[p - 1] + 2;
+		max = count - 2 * (parts - p);
+		c = min;
+		while (c < max && fabs(prefix[c + 1] - target) <= fabs(prefix[c] - target))
+			c++;
+		cuts[p] = c;
+	}
+
+	free(prefix);
+}
+
+/****************************************************/
+/**
+ * Affiche la grille de processus et le volume des mailles fantômes échangées à chaque pas.
+ * @param comm Découpage du domaine.
+**/
+void lbm_comm_print_grid( const lbm_comm_t * comm, int total_width, int total_height )
+{
+	long cells = lbm_comm_halo_cells(comm->nb_x, comm->nb_y, total_width, total_height);
+	printf("\033[32mProcess grid %d x %d, sub-domains of %d x %d cells, halo of %ld cells (%.2f MB) per step\033[39m\n",
+		comm->nb_x, comm->nb_y,
+		total_width / comm->nb_x, total_height / comm->nb_y,
+		cells, (double)cells * DIRECTIONS * sizeof(double) / 1e6);
+}
+
 /****************************************************/
 /**
  * Affiche la configuation du lbm_comm pour un rank donné
@@ -51,3 +159,1071 @@ void  lbm_comm_print( lbm_comm_t *comm )
 		comm->width,
 		comm->height);
 }
+
+/****************************************************/
+/** Fenêtre mémoire partagée dans laquelle sont allouées les mailles d'un maillage. **/
+typedef struct lbm_comm_shared_window_s
+{
+	/** Mailles allouées dans la fenêtre, NULL si l'entrée est libre. **/
+	double * cells;
+	/** Fenêtre partagée par les rangs du noeud. **/
+	MPI_Win window;
+} lbm_comm_shared_window_t;
+
+/****************************************************/
+/** Communicateur des rangs partageant la mémoire du noeud, créé au premier appel. **/
+static MPI_Comm lbm_gbl_shared_node = MPI_COMM_NULL;
+/** Fenêtres des maillages alloués par lbm_comm_shared_alloc(). **/
+static lbm_comm_shared_window_t * lbm_gbl_shared_windows = NULL;
+/** Nombre d'entrées de lbm_gbl_shared_windows. **/
+static int lbm_gbl_shared_windows_count = 0;
+
+/****************************************************/
+/**
+ * Retourne le communicateur regroupant les rangs de MPI_COMM_WORLD pouvant partager
+ * leur mémoire (même noeud). Il est créé au premier appel qui doit être fait par tous les rangs.
+**/
+MPI_Comm lbm_comm_shared_node( void )
+{
+	if (lbm_gbl_shared_node == MPI_COMM_NULL)
+		MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &lbm_gbl_shared_node );
+	return lbm_gbl_shared_node;
+}
+
+/****************************************************/
+/**
+ * Alloue les mailles d'un maillage dans une fenêtre partagée avec les rangs du noeud
+ * pour qu'ils puissent lire directement nos bords. Collectif sur lbm_comm_shared_node(),
+ * tous les rangs doivent allouer leurs maillages dans le même ordre. Chaque segment
+ * reste dans la mémoire de son propriétaire (noncontig).
+ * @param size Taille en octets.
+**/
+double * lbm_comm_shared_alloc( size_t size )
+{
+	//vars
+	int i;
+	MPI_Info info;
+	lbm_comm_shared_window_t * entry;
+
+	//free entry or a new one
+	for ( i = 0 ; i < lbm_gbl_shared_windows_count ; i++ )
+		if (lbm_gbl_shared_windows[i].cells == NULL)
+			break;
+	if (i == lbm_gbl_shared_windows_count)
+		lbm_gbl_shared_windows = realloc( lbm_gbl_shared_windows, ++lbm_gbl_shared_windows_count * sizeof(lbm_comm_shared_window_t) );
+	entry = &lbm_gbl_shared_windows[i];
+
+	//alloc
+	MPI_Info_create( &info );
+	MPI_Info_set( info, "alloc_shared_noncontig", "true" );
+	MPI_Win_allocate_shared( size, sizeof( double ), info, lbm_comm_shared_node(), &entry->cells, &entry->window );
+	MPI_Info_free( &info );
+
+	//passive target epoch for the whole life of the mesh, required by MPI_Win_sync()
+	MPI_Win_lock_all( MPI_MODE_NOCHECK, entry->window );
+
+	return entry->cells;
+}
+
+/****************************************************/
+/**
+ * Retourne la fenêtre dans laquelle les mailles ont été allouées, MPI_WIN_NULL si elles
+ * ne viennent pas de lbm_comm_shared_alloc().
+**/
+MPI_Win lbm_comm_shared_window( const double * cells )
+{
+	//vars
+	int i;
+
+	//search
+	for ( i = 0 ; i < lbm_gbl_shared_windows_count ; i++ )
+		if (cells != NULL && lbm_gbl_shared_windows[i].cells == cells)
+			return lbm_gbl_shared_windows[i].window;
+
+	return MPI_WIN_NULL;
+}
+
+/****************************************************/
+/**
+ * Libère des mailles allouées par lbm_comm_shared_alloc(). Collectif sur
+ * lbm_comm_shared_node().
+**/
+void lbm_comm_shared_free( double * cells )
+{
+	//vars
+	int i;
+
+	//search
+	for ( i = 0 ; i < lbm_gbl_shared_windows_count ; i++ )
+		if (cells != NULL && lbm_gbl_shared_windows[i].cells == cells)
+			break;
+	assert(i < lbm_gbl_shared_windows_count);
+
+	//free
+	MPI_Win_unlock_all( lbm_gbl_shared_windows[i].window );
+	MPI_Win_free( &lbm_gbl_shared_windows[i].window );
+	lbm_gbl_shared_windows[i].cells = NULL;
+}
+
+/****************************************************/
+/**
+ * Élargit le maillage local à HALO_DEPTH couches de mailles fantômes du côté des voisins,
+ * à appeler après l'initialisation du découpage de l'exercice (une seule couche). Les
+ * côtés au bord du maillage global gardent une couche pour les conditions aux limites.
+ * Les couches supplémentaires sont calculées en double par les deux voisins, l'échange
+ * n'a alors lieu que tous les HALO_DEPTH pas (lbm_comm_ghost_exchange_ex_select()).
+**/
+void lbm_comm_init_halo( lbm_comm_t * comm )
+{
+	//errors, the ghost cells must come from the direct neighboor
+	if ((comm->nb_x > 1 && comm->width - 2 < HALO_DEPTH) || (comm->nb_y > 1 && comm->height - 2 < HALO_DEPTH))
+		fatal("halo_depth is larger than the local sub-domain !");
+
+	//add the layers
+	comm->halo = HALO_DEPTH;
+	comm->halo_steps = 0;
+	comm->width += lbm_comm_ghost_left(comm) + lbm_comm_ghost_right(comm) - 2;
+	comm->height += lbm_comm_ghost_top(comm) + lbm_comm_ghost_bottom(comm) - 2;
+}
+
+/****************************************************/
+/**
+ * Avec EXCHANGE_MODE = LBM_EXCHANGE_SHARED, cherche les voisins placés sur le même noeud
+ * (comm->shared_ranks) et la taille de leur maillage local pour lire directement leurs
+ * mailles dans les fenêtres mémoire partagées. Collectif sur lbm_comm_shared_node().
+ * Dans les autres modes tous les voisins sont joints par messages.
+**/
+static void lbm_comm_shared_init( lbm_comm_t * comm )
+{
+	//vars
+	int i, dx, dy, rank, node_size;
+	int size[2] = {comm->width, comm->height};
+	int * sizes;
+	MPI_Comm node;
+	MPI_Group group, node_group;
+
+	//default, no neighboor on the node
+	for ( i = 0 ; i < 9 ; i++ )
+	{
+		comm->shared_ranks[i] = MPI_UNDEFINED;
+		comm->shared_widths[i] = 0;
+		comm->shared_heights[i] = 0;
+	}
+	comm->shared_mesh = NULL;
+	if (EXCHANGE_MODE != LBM_EXCHANGE_SHARED)
+		return;
+
+	//sizes of the meshes of the node, they differ with the uneven splittings
+	node = lbm_comm_shared_node();
+	MPI_Comm_size( node, &node_size );
+	sizes = malloc( 2 * node_size * sizeof(int) );
+	MPI_Allgather( size, 2, MPI_INT, sizes, 2, MPI_INT, node );
+
+	//rank of the neighboors in the node communicator
+	MPI_Comm_group( comm->communicator, &group );
+	MPI_Comm_group( node, &node_group );
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			if ((dx == 0 && dy == 0) || rank == MPI_PROC_NULL)
+				continue;
+			i = (dy + 1) * 3 + (dx + 1);
+			MPI_Group_translate_ranks( group, 1, &rank, node_group, &comm->shared_ranks[i] );
+			if (comm->shared_ranks[i] != MPI_UNDEFINED)
+			{
+				comm->shared_widths[i] = sizes[2 * comm->shared_ranks[i]];
+				comm->shared_heights[i] = sizes[2 * comm->shared_ranks[i] + 1];
+			}
+		}
+	}
+
+	//free
+	MPI_Group_free( &group );
+	MPI_Group_free( &node_group );
+	free( sizes );
+}
+
+/****************************************************/
+/**
+ * Avec EXCHANGE_MODE = LBM_EXCHANGE_RMA, récupère la taille du maillage des voisins et
+ * construit pour chacun le type décrivant ses mailles fantômes qui nous font face, cible
+ * des MPI_Put de lbm_comm_ghost_exchange_start(). Les zones sont les mêmes que l'échange
+ * par messages, les coins venant des voisins en diagonale.
+**/
+static void lbm_comm_rma_init( lbm_comm_t * comm )
+{
+	//vars
+	int i, dx, dy, x, y, rank, width, height;
+	int count = 0;
+	int size[2] = {comm->width, comm->height};
+	int sizes[9][2];
+	int ranks[8];
+	int cell_stride = (MESH_LAYOUT == LBM_LAYOUT_AOS) ? DIRECTIONS : 1;
+	int count_y = comm->height - (comm->rank_y > 0) - (comm->rank_y < comm->nb_y - 1);
+	int count_x = comm->width - (comm->rank_x > 0) - (comm->rank_x < comm->nb_x - 1);
+	MPI_Request requests[LBM_COMM_NEIGHBOUR_REQUESTS];
+	MPI_Datatype cell_type;
+	MPI_Group group;
+
+	//default, nothing to exchange in one-sided
+	comm->rma_group = MPI_GROUP_NULL;
+	comm->rma_active = MPI_WIN_NULL;
+	for ( i = 0 ; i < LBM_COMM_PERSISTENT_MESHES ; i++ )
+	{
+		comm->rma_windows[i] = MPI_WIN_NULL;
+		comm->rma_cells[i] = NULL;
+	}
+	for ( i = 0 ; i < 9 ; i++ )
+	{
+		comm->rma_types[i] = MPI_DATATYPE_NULL;
+		comm->rma_displs[i] = 0;
+	}
+	//alone, no window (some MPI do not create them for a single process)
+	if (EXCHANGE_MODE != LBM_EXCHANGE_RMA || comm->nb_x * comm->nb_y == 1)
+		return;
+
+	//sizes of the meshes of the neighboors, they differ with the uneven splittings
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			if ((dx == 0 && dy == 0) || rank == MPI_PROC_NULL)
+				continue;
+			i = (dy + 1) * 3 + (dx + 1);
+			MPI_Irecv( sizes[i], 2, MPI_INT, rank, LBM_COMM_TAG_SIZES, comm->communicator, &requests[2 * count] );
+			MPI_Isend( size, 2, MPI_INT, rank, LBM_COMM_TAG_SIZES, comm->communicator, &requests[2 * count + 1] );
+			ranks[count++] = rank;
+		}
+	}
+	MPI_Waitall( 2 * count, requests, MPI_STATUSES_IGNORE );
+
+	//neighboors group for post/start
+	MPI_Comm_group( comm->communicator, &group );
+	MPI_Group_incl( group, count, ranks, &comm->rma_group );
+	MPI_Group_free( &group );
+
+	//ghost cells of the neighboors
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			if ((dx == 0 && dy == 0) || lbm_comm_neighbour_rank(comm, dx, dy) == MPI_PROC_NULL)
+				continue;
+			i = (dy + 1) * 3 + (dx + 1);
+			width = sizes[i][0];
+			height = sizes[i][1];
+
+			//position in its mesh, the neighboors along the sides share our first cell
+			if (dx > 0)
+				x = 0;
+			else if (dx < 0)
+				x = width - 1;
+			else
+				x = (comm->rank_x > 0) ? 1 : 0;
+			if (dy > 0)
+				y = 0;
+			else if (dy < 0)
+				y = height - 1;
+			else
+				y = (comm->rank_y > 0) ? 1 : 0;
+			comm->rma_displs[i] = (x * height + y) * cell_stride;
+
+			//shape with its strides
+			MPI_Type_vector( DIRECTIONS, 1, (MESH_LAYOUT == LBM_LAYOUT_AOS) ? 1 : width * height, MPI_DOUBLE, &cell_type );
+			if (dx == 0) {
+				MPI_Type_create_hvector( count_x, 1, height * cell_stride * sizeof(double), cell_type, &comm->rma_types[i] );
+				MPI_Type_free( &cell_type );
+			} else if (dy == 0) {
+				MPI_Type_create_hvector( count_y, 1, cell_stride * sizeof(double), cell_type, &comm->rma_types[i] );
+				MPI_Type_free( &cell_type );
+			} else {
+				comm->rma_types[i] = cell_type;
+			}
+			MPI_Type_commit( &comm->rma_types[i] );
+		}
+	}
+}
+
+/****************************************************/
+/** Libère les fenêtres, types et groupe de lbm_comm_rma_init(), collectif. **/
+static void lbm_comm_rma_release( lbm_comm_t * comm )
+{
+	//vars
+	int i;
+
+	//free
+	for ( i = 0 ; i < LBM_COMM_PERSISTENT_MESHES ; i++ )
+	{
+		if (comm->rma_windows[i] != MPI_WIN_NULL)
+			MPI_Win_free( &comm->rma_windows[i] );
+		comm->rma_cells[i] = NULL;
+	}
+	for ( i = 0 ; i < 9 ; i++ )
+		if (comm->rma_types[i] != MPI_DATATYPE_NULL)
+			MPI_Type_free( &comm->rma_types[i] );
+	if (comm->rma_group != MPI_GROUP_NULL)
+		MPI_Group_free( &comm->rma_group );
+}
+
+/****************************************************/
+/**
+ * Construit les types MPI décrivant les parties du maillage local à échanger en
+ * fonction du placement mémoire des mailles (MESH_LAYOUT).
+ * @param comm Configuration du découpage, width et height doivent être définis.
+**/
+void  lbm_comm_init_mesh_types( lbm_comm_t * comm )
+{
+	//vars
+	int i, k, dx, dy, count;
+	int cell_stride = DIRECTIONS;
+	int direction_stride = 1;
+	int displacements[DIRECTIONS];
+	MPI_Datatype cell_type;
+	MPI_Datatype column_part;
+	MPI_Datatype column_part_halo;
+
+	switch (MESH_LAYOUT)
+	{
+		case LBM_LAYOUT_AOS:
+			//the cells of a column are contiguous with all their directions
+			MPI_Type_contiguous( comm->height * DIRECTIONS, MPI_DOUBLE, &comm->column_type );
+			cell_stride = DIRECTIONS;
+			direction_stride = 1;
+			break;
+		case LBM_LAYOUT_SOA:
+			//one block of height cells in each direction plane
+			MPI_Type_vector( DIRECTIONS, comm->height, comm->width * comm->height, MPI_DOUBLE, &comm->column_type );
+			cell_stride = 1;
+			direction_stride = comm->width * comm->height;
+			break;
+	}
+	MPI_Type_commit( &comm->column_type );
+
+	//one cell, then the parts of the columns and lines used by the non-blocking exchange
+	//(halo layers). The ghost corners shared with a neighboor in both directions come from
+	//the diagonal neighboor.
+	int count_y = comm->height - (comm->rank_y > 0) * comm->halo - (comm->rank_y < comm->nb_y - 1) * comm->halo;
+	int count_x = comm->width - (comm->rank_x > 0) * comm->halo - (comm->rank_x < comm->nb_x - 1) * comm->halo;
+	MPI_Type_vector( DIRECTIONS, 1, direction_stride, MPI_DOUBLE, &comm->cell_type );
+	MPI_Type_create_hvector( count_y, 1, cell_stride * sizeof(double), comm->cell_type, &column_part );
+	MPI_Type_create_hvector( comm->halo, 1, comm->height * cell_stride * sizeof(double), column_part, &comm->overlap_column_type );
+	MPI_Type_create_hvector( comm->halo, 1, cell_stride * sizeof(double), comm->cell_type, &column_part_halo );
+	MPI_Type_create_hvector( count_x, 1, comm->height * cell_stride * sizeof(double), column_part_halo, &comm->overlap_line_type );
+	MPI_Type_create_hvector( comm->halo, 1, comm->height * cell_stride * sizeof(double), column_part_halo, &comm->overlap_corner_type );
+	MPI_Type_free( &column_part );
+	MPI_Type_free( &column_part_halo );
+	MPI_Type_commit( &comm->cell_type );
+	MPI_Type_commit( &comm->overlap_column_type );
+	MPI_Type_commit( &comm->overlap_line_type );
+	MPI_Type_commit( &comm->overlap_corner_type );
+
+	//same parts with only the populations crossing the face (3) or corner (1) toward the neighboor (dx,dy)
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			//center is not used
+			MPI_Datatype * type = &comm->directional_types[(dy + 1) * 3 + (dx + 1)];
+			*type = MPI_DATATYPE_NULL;
+			if (dx == 0 && dy == 0)
+				continue;
+
+			//select populations
+			count = 0;
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				if ((dx == 0 || direction_matrix[k][0] == dx) && (dy == 0 || direction_matrix[k][1] == dy))
+					displacements[count++] = k * direction_stride;
+			MPI_Type_create_indexed_block( count, 1, displacements, MPI_DOUBLE, &cell_type );
+
+			//shape of the part
+			if (dx == 0) {
+				MPI_Type_create_hvector( count_x, 1, comm->height * cell_stride * sizeof(double), cell_type, type );
+				MPI_Type_free( &cell_type );
+			} else if (dy == 0) {
+				MPI_Type_create_hvector( count_y, 1, cell_stride * sizeof(double), cell_type, type );
+				MPI_Type_free( &cell_type );
+			} else {
+				*type = cell_type;
+			}
+			MPI_Type_commit( type );
+		}
+	}
+
+	comm->request_count = 0;
+	comm->request_first = 0;
+	for ( i = 0 ; i < LBM_COMM_PERSISTENT_MESHES ; i++ )
+	{
+		comm->persistent_cells[i] = NULL;
+		comm->persistent_count[i] = 0;
+	}
+
+	//neighboors reached through the shared memory
+	lbm_comm_shared_init( comm );
+
+	//targets of the one-sided exchange
+	lbm_comm_rma_init( comm );
+}
+
+/****************************************************/
+/**
+ * Libère les requêtes persistantes du maillage d'index slot.
+**/
+static void lbm_comm_persistent_release( lbm_comm_t * comm, int slot )
+{
+	int i;
+	for ( i = 0 ; i < comm->persistent_count[slot] ; i++ )
+		MPI_Request_free( &comm->requests[slot * LBM_COMM_NEIGHBOUR_REQUESTS + i] );
+	comm->persistent_cells[slot] = NULL;
+	comm->persistent_count[slot] = 0;
+}
+
+/****************************************************/
+/**
+ * Libère les types construits par lbm_comm_init_mesh_types(), les requêtes persistantes
+ * et les fenêtres de l'échange one-sided.
+**/
+void  lbm_comm_release_mesh_types( lbm_comm_t * comm )
+{
+	//vars
+	int i;
+
+	//persistent requests
+	for ( i = 0 ; i < LBM_COMM_PERSISTENT_MESHES ; i++ )
+		lbm_comm_persistent_release( comm, i );
+
+	MPI_Type_free( &comm->column_type );
+	MPI_Type_free( &comm->cell_type );
+	MPI_Type_free( &comm->overlap_column_type );
+	MPI_Type_free( &comm->overlap_line_type );
+	MPI_Type_free( &comm->overlap_corner_type );
+	for ( i = 0 ; i < 9 ; i++ )
+		if (comm->directional_types[i] != MPI_DATATYPE_NULL)
+			MPI_Type_free( &comm->directional_types[i] );
+	//one-sided exchange
+	lbm_comm_rma_release( comm );
+}
+
+/****************************************************/
+/**
+ * Rang du voisin à la position (rank_x + dx, rank_y + dy) dans la grille des processus
+ * (rangs numérotés ligne par ligne comme dans les exercices), MPI_PROC_NULL en dehors.
+ * Si comm->communicator est une topologie cartésienne les rangs ont pu être renumérotés,
+ * ils sont alors demandés à MPI.
+**/
+int lbm_comm_neighbour_rank( const lbm_comm_t * comm, int dx, int dy )
+{
+	int status, rank;
+	int coords[2];
+	int rank_x = comm->rank_x + dx;
+	int rank_y = comm->rank_y + dy;
+	if (rank_x < 0 || rank_x >= comm->nb_x || rank_y < 0 || rank_y >= comm->nb_y)
+		return MPI_PROC_NULL;
+
+	//cartesian topology
+	MPI_Topo_test( comm->communicator, &status );
+	if (status == MPI_CART) {
+		coords[XID] = rank_x;
+		coords[YID] = rank_y;
+		MPI_Cart_rank( comm->communicator, coords, &rank );
+		return rank;
+	}
+
+	return rank_y * comm->nb_x + rank_x;
+}
+
+/****************************************************/
+/** Copie les mailles de la colonne x dans buffer (directions contigües). **/
+static void lbm_comm_aa_pack_column( double * buffer, const lbm_mesh_t * mesh, int x )
+{
+	int j;
+	for ( j = 0 ; j < mesh->height ; j++ )
+		lbm_mesh_load_cell(mesh, x, j, &buffer[j * DIRECTIONS]);
+}
+
+/****************************************************/
+/** Copie les mailles de la ligne y dans buffer en incluant les coins de l'anneau (x = -1 et x = width). **/
+static void lbm_comm_aa_pack_line( double * buffer, const lbm_mesh_t * mesh, int y )
+{
+	int i,k;
+	for ( i = -1 ; i <= mesh->width ; i++ )
+	{
+		if (i < 0 || i >= mesh->width) {
+			const double * cell = lbm_mesh_get_halo_cell(mesh, i, y);
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				buffer[(i + 1) * DIRECTIONS + k] = cell[k];
+		} else {
+			lbm_mesh_load_cell(mesh, i, y, &buffer[(i + 1) * DIRECTIONS]);
+		}
+	}
+}
+
+/****************************************************/
+/**
+ * Remplit l'anneau aa_halo avant un pas impair du streaming AA. Les mailles locales
+ * et celles des voisins se recouvrent sur deux colonnes (lignes), la colonne width de
+ * l'anneau correspond donc à la colonne 2 du voisin de droite. Après un pas pair
+ * celle-ci contient les valeurs qui doivent entrer dans nos mailles fantômes.
+ * Les échanges sont faits d'abord horizontalement puis verticalement en incluant les
+ * coins, les voisins diagonaux sont ainsi couverts sans communication dédiée. Sur les
+ * bords du domaine global l'anneau garde les valeurs écrites par le pas pair.
+ * @param comm Découpage du domaine.
+ * @param mesh Maillage après lbm_phys_aa_even_step().
+**/
+void lbm_comm_aa_halo_exchange( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	const int width = mesh->width;
+	const int height = mesh->height;
+	const int line_size = (width + 2) * DIRECTIONS;
+	const int column_size = height * DIRECTIONS;
+	const int left = lbm_comm_neighbour_rank(comm, -1, 0);
+	const int right = lbm_comm_neighbour_rank(comm, +1, 0);
+	const int up = lbm_comm_neighbour_rank(comm, 0, -1);
+	const int down = lbm_comm_neighbour_rank(comm, 0, +1);
+	double * buffer = mesh->aa_buffer;
+
+	//errors
+	assert(mesh->aa_halo != NULL);
+	assert(mesh->aa_buffer != NULL);
+	assert(mesh->aa_swapped != 0);
+	assert(width == comm->width && height == comm->height);
+	assert(comm->nb_x == 1 || width >= 4);
+	assert(comm->nb_y == 1 || height >= 4);
+
+	//left & right
+	if (left != MPI_PROC_NULL)
+		lbm_comm_aa_pack_column(buffer, mesh, 2);
+	MPI_Sendrecv( buffer, column_size, MPI_DOUBLE, left, 0,
+	              lbm_mesh_get_halo_cell(mesh, width, 0), column_size, MPI_DOUBLE, right, 0,
+	              comm->communicator, MPI_STATUS_IGNORE );
+	if (right != MPI_PROC_NULL)
+		lbm_comm_aa_pack_column(buffer, mesh, width - 3);
+	MPI_Sendrecv( buffer, column_size, MPI_DOUBLE, right, 1,
+	              lbm_mesh_get_halo_cell(mesh, -1, 0), column_size, MPI_DOUBLE, left, 1,
+	              comm->communicator, MPI_STATUS_IGNORE );
+
+	//top & bottom with corners
+	if (up != MPI_PROC_NULL)
+		lbm_comm_aa_pack_line(buffer, mesh, 2);
+	MPI_Sendrecv( buffer, line_size, MPI_DOUBLE, up, 2,
+	              lbm_mesh_get_halo_cell(mesh, -1, height), line_size, MPI_DOUBLE, down, 2,
+	              comm->communicator, MPI_STATUS_IGNORE );
+	if (down != MPI_PROC_NULL)
+		lbm_comm_aa_pack_line(buffer, mesh, height - 3);
+	MPI_Sendrecv( buffer, line_size, MPI_DOUBLE, down, 3,
+	              lbm_mesh_get_halo_cell(mesh, -1, -1), line_size, MPI_DOUBLE, up, 3,
+	              comm->communicator, MPI_STATUS_IGNORE );
+}
+
+/****************************************************/
+/**
+ * Position dans le maillage local de la zone échangée avec le voisin (dx,dy) : les
+ * mailles fantômes reçues si ghost est vrai, sinon les mailles envoyées.
+ * @return Le type MPI décrivant la zone à partir de la maille (*x,*y).
+**/
+static MPI_Datatype lbm_comm_overlap_region( const lbm_comm_t * comm, int dx, int dy, int ghost, int * x, int * y )
+{
+	//along the side the corners are excluded when they come from a diagonal neighboor
+	const int halo = comm->halo;
+	const int first_x = (comm->rank_x > 0) ? halo : 0;
+	const int first_y = (comm->rank_y > 0) ? halo : 0;
+
+	//position, halo layers
+	if (dx < 0)
+		*x = ghost ? 0 : halo;
+	else if (dx > 0)
+		*x = ghost ? comm->width - halo : comm->width - 2 * halo;
+	else
+		*x = first_x;
+	if (dy < 0)
+		*y = ghost ? 0 : halo;
+	else if (dy > 0)
+		*y = ghost ? comm->height - halo : comm->height - 2 * halo;
+	else
+		*y = first_y;
+
+	//type
+	if (dx == 0)
+		return comm->overlap_line_type;
+	else if (dy == 0)
+		return comm->overlap_column_type;
+	else
+		return comm->overlap_corner_type;
+}
+
+/****************************************************/
+/**
+ * Les populations qui ne traversent pas le bord ne sont utiles qu'aux mailles fantômes
+ * après la collision. Les pas fused et aa échangent les mailles avant la collision, la
+ * collision des mailles fantômes a alors besoin de toutes les populations.
+**/
+static int lbm_comm_use_directional( void )
+{
+	return EXCHANGE_MODE == LBM_EXCHANGE_DIRECTIONAL && (STEP_MODE == LBM_STEP_CLASSIC || STEP_MODE == LBM_STEP_OVERLAP);
+}
+
+/****************************************************/
+/**
+ * Crée ou poste les requêtes de l'échange avec les 8 voisins dans requests.
+ * @param persistent Si vrai, crée des requêtes persistantes (MPI_Send_init/MPI_Recv_init)
+ * qui ne sont pas démarrées, sinon démarre directement les communications.
+ * @return Le nombre de requêtes.
+**/
+static int lbm_comm_neighbour_requests( lbm_comm_t * comm, lbm_mesh_t * mesh, MPI_Request * requests, int persistent )
+{
+	//vars
+	int dx, dy, x, y, rank, tag;
+	int count = 0;
+	int directional = lbm_comm_use_directional();
+	MPI_Datatype type;
+
+	//loop on neighboors, the tag is the direction of the message
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			//skip, the neighboors of the node are read in the shared memory
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			if ((dx == 0 && dy == 0) || rank == MPI_PROC_NULL || comm->shared_ranks[(dy + 1) * 3 + (dx + 1)] != MPI_UNDEFINED)
+				continue;
+
+			//receive in ghost cells, only the populations coming toward us in directional mode
+			type = lbm_comm_overlap_region(comm, dx, dy, 1, &x, &y);
+			tag = (1 - dy) * 3 + (1 - dx);
+			if (directional)
+				type = comm->directional_types[tag];
+			if (persistent)
+				MPI_Recv_init( lbm_mesh_get_cell(mesh, x, y), 1, type, rank, tag, comm->communicator, &requests[count++] );
+			else
+				MPI_Irecv( lbm_mesh_get_cell(mesh, x, y), 1, type, rank, tag, comm->communicator, &requests[count++] );
+
+			//send our border
+			type = lbm_comm_overlap_region(comm, dx, dy, 0, &x, &y);
+			tag = (1 + dy) * 3 + (1 + dx);
+			if (directional)
+				type = comm->directional_types[tag];
+			if (persistent)
+				MPI_Send_init( lbm_mesh_get_cell(mesh, x, y), 1, type, rank, tag, comm->communicator, &requests[count++] );
+			else
+				MPI_Isend( lbm_mesh_get_cell(mesh, x, y), 1, type, rank, tag, comm->communicator, &requests[count++] );
+		}
+	}
+
+	return count;
+}
+
+/****************************************************/
+/**
+ * Cherche les requêtes persistantes du maillage, elles sont créées au premier échange
+ * de chaque maillage (le pas de temps alterne entre deux tableaux de mailles).
+ * @return L'index du maillage dans comm->persistent_cells.
+**/
+static int lbm_comm_persistent_slot( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int slot;
+
+	//search
+	for ( slot = 0 ; slot < LBM_COMM_PERSISTENT_MESHES ; slot++ )
+		if (comm->persistent_cells[slot] == mesh->cells)
+			return slot;
+
+	//free slot, if none recycle the first one
+	for ( slot = 0 ; slot < LBM_COMM_PERSISTENT_MESHES ; slot++ )
+		if (comm->persistent_cells[slot] == NULL)
+			break;
+	if (slot == LBM_COMM_PERSISTENT_MESHES)
+	{
+		slot = 0;
+		lbm_comm_persistent_release( comm, slot );
+	}
+
+	//create
+	comm->persistent_cells[slot] = mesh->cells;
+	comm->persistent_count[slot] = lbm_comm_neighbour_requests( comm, mesh, &comm->requests[slot * LBM_COMM_NEIGHBOUR_REQUESTS], 1 );
+	return slot;
+}
+
+/****************************************************/
+/**
+ * Démarre l'échange en mémoire partagée : les voisins des autres noeuds passent par
+ * des messages, ceux du noeud sont prévenus que notre bord est prêt à être lu.
+ * @return Le nombre de requêtes postées dans comm->requests.
+**/
+static int lbm_comm_shared_start( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int dx, dy, rank, count;
+
+	//errors
+	assert(lbm_comm_shared_window( mesh->cells ) != MPI_WIN_NULL);
+
+	//make our border visible to the other ranks of the node
+	MPI_Win_sync( lbm_comm_shared_window( mesh->cells ) );
+
+	//other nodes
+	count = lbm_comm_neighbour_requests( comm, mesh, comm->requests, 0 );
+
+	//our border is ready, wait the same for the neighboors of the node
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			if (comm->shared_ranks[(dy + 1) * 3 + (dx + 1)] == MPI_UNDEFINED)
+				continue;
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			MPI_Irecv( NULL, 0, MPI_BYTE, rank, LBM_COMM_TAG_SHARED_READY, comm->communicator, &comm->requests[count++] );
+			MPI_Isend( NULL, 0, MPI_BYTE, rank, LBM_COMM_TAG_SHARED_READY, comm->communicator, &comm->requests[count++] );
+		}
+	}
+
+	comm->shared_mesh = mesh;
+	return count;
+}
+
+/****************************************************/
+/**
+ * Copie dans nos mailles fantômes la zone (dx,dy) directement depuis le maillage du
+ * voisin, lu dans la fenêtre partagée. Ce sont les mêmes zones que
+ * lbm_comm_ghost_exchange_start(), les coins venant des voisins en diagonale.
+**/
+static void lbm_comm_shared_copy( const lbm_comm_t * comm, lbm_mesh_t * mesh, int dx, int dy )
+{
+	//vars
+	int i, k, x, y, sx, sy, disp_unit;
+	int count = 1, step_x = 0, step_y = 0;
+	const int index = (dy + 1) * 3 + (dx + 1);
+	MPI_Aint size;
+	lbm_mesh_t remote = *mesh;
+
+	//mesh of the neighboor, same layout with its own size
+	MPI_Win_shared_query( lbm_comm_shared_window( mesh->cells ), comm->shared_ranks[index], &size, &disp_unit, &remote.cells );
+	remote.width = comm->shared_widths[index];
+	remote.height = comm->shared_heights[index];
+	if (remote.layout == LBM_LAYOUT_SOA)
+		remote.direction_stride = remote.width * remote.height;
+
+	//our ghost cells and the border of the neighboor facing them, the neighboors
+	//along the sides share our first cell and count
+	lbm_comm_overlap_region( comm, dx, dy, 1, &x, &y );
+	sx = (dx < 0) ? remote.width - 2 : ((dx > 0) ? 1 : x);
+	sy = (dy < 0) ? remote.height - 2 : ((dy > 0) ? 1 : y);
+	if (dx == 0) {
+		count = comm->width - (comm->rank_x > 0) - (comm->rank_x < comm->nb_x - 1);
+		step_x = 1;
+	} else if (dy == 0) {
+		count = comm->height - (comm->rank_y > 0) - (comm->rank_y < comm->nb_y - 1);
+		step_y = 1;
+	}
+
+	//a part of column is contiguous with the aos layout
+	if (step_y && mesh->layout == LBM_LAYOUT_AOS) {
+		memcpy( lbm_mesh_get_cell(mesh, x, y), lbm_mesh_get_cell(&remote, sx, sy), count * DIRECTIONS * sizeof(double) );
+		return;
+	}
+
+	for ( i = 0 ; i < count ; i++ )
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+			*lbm_mesh_get_value(mesh, x + i * step_x, y + i * step_y, k) = *lbm_mesh_get_value(&remote, sx + i * step_x, sy + i * step_y, k);
+}
+
+/****************************************************/
+/**
+ * Termine l'échange en mémoire partagée une fois les bords des voisins du noeud prêts :
+ * copie leurs mailles puis les prévient qu'ils peuvent à nouveau modifier leur bord.
+ * On attend le même signal de leur part avant de rendre la main pour ne pas réécrire
+ * notre bord pendant qu'ils le lisent.
+**/
+static void lbm_comm_shared_finish( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int dx, dy, rank;
+	int count = 0;
+	MPI_Request requests[LBM_COMM_NEIGHBOUR_REQUESTS];
+
+	//see the writes of the neighboors
+	MPI_Win_sync( lbm_comm_shared_window( mesh->cells ) );
+
+	//read
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			if (comm->shared_ranks[(dy + 1) * 3 + (dx + 1)] == MPI_UNDEFINED)
+				continue;
+			lbm_comm_shared_copy( comm, mesh, dx, dy );
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			MPI_Irecv( NULL, 0, MPI_BYTE, rank, LBM_COMM_TAG_SHARED_DONE, comm->communicator, &requests[count++] );
+			MPI_Isend( NULL, 0, MPI_BYTE, rank, LBM_COMM_TAG_SHARED_DONE, comm->communicator, &requests[count++] );
+		}
+	}
+
+	MPI_Waitall( count, requests, MPI_STATUSES_IGNORE );
+}
+
+/****************************************************/
+/**
+ * Cherche la fenêtre exposant les mailles du maillage, elle est créée au premier échange
+ * de chaque maillage comme les requêtes persistantes. Collectif sur comm->communicator,
+ * tous les rangs échangent les mêmes maillages dans le même ordre.
+**/
+static MPI_Win lbm_comm_rma_window( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int slot;
+	MPI_Info info;
+
+	//search
+	for ( slot = 0 ; slot < LBM_COMM_PERSISTENT_MESHES ; slot++ )
+		if (comm->rma_cells[slot] == mesh->cells)
+			return comm->rma_windows[slot];
+
+	//free slot, if none recycle the first one
+	for ( slot = 0 ; slot < LBM_COMM_PERSISTENT_MESHES ; slot++ )
+		if (comm->rma_cells[slot] == NULL)
+			break;
+	if (slot == LBM_COMM_PERSISTENT_MESHES)
+	{
+		slot = 0;
+		MPI_Win_free( &comm->rma_windows[slot] );
+	}
+
+	//create, only synchronized by post/start/complete/wait
+	MPI_Info_create( &info );
+	MPI_Info_set( info, "no_locks", "true" );
+	MPI_Win_create( mesh->cells, mesh->width * mesh->height * DIRECTIONS * sizeof(double), sizeof(double),
+	                info, comm->communicator, &comm->rma_windows[slot] );
+	MPI_Info_free( &info );
+	comm->rma_cells[slot] = mesh->cells;
+	return comm->rma_windows[slot];
+}
+
+/****************************************************/
+/**
+ * Démarre l'échange one-sided : ouvre l'exposition de nos mailles fantômes et l'accès à
+ * celles des voisins (le groupe des voisins seulement, pas de fence globale) puis y écrit
+ * notre bord avec MPI_Put. Les epochs sont fermées par lbm_comm_ghost_exchange_wait().
+**/
+static void lbm_comm_rma_start( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int dx, dy, x, y, index;
+	MPI_Datatype type;
+	MPI_Win window;
+
+	//no neighboor
+	if (comm->rma_group == MPI_GROUP_NULL)
+		return;
+
+	//epochs
+	window = lbm_comm_rma_window( comm, mesh );
+	MPI_Win_post( comm->rma_group, 0, window );
+	MPI_Win_start( comm->rma_group, 0, window );
+
+	//put our border in the ghost cells of the neighboors
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			index = (dy + 1) * 3 + (dx + 1);
+			if (comm->rma_types[index] == MPI_DATATYPE_NULL)
+				continue;
+			type = lbm_comm_overlap_region(comm, dx, dy, 0, &x, &y);
+			MPI_Put( lbm_mesh_get_cell(mesh, x, y), 1, type, lbm_comm_neighbour_rank(comm, dx, dy),
+			         comm->rma_displs[index], 1, comm->rma_types[index], window );
+		}
+	}
+
+	comm->rma_active = window;
+}
+
+/****************************************************/
+/**
+ * Démarre l'échange non bloquant des mailles fantômes avec les 8 voisins, pour les
+ * découpages 1D et 2D. Les mailles envoyées (première couche de mailles réelles) doivent
+ * être calculées avant l'appel, elles ne doivent pas être modifiées ni les mailles
+ * fantômes lues avant lbm_comm_ghost_exchange_wait(). Le résultat est le même que
+ * l'échange en deux temps (horizontal puis vertical) des exercices.
+ * Avec EXCHANGE_MODE = LBM_EXCHANGE_PERSISTENT ou LBM_EXCHANGE_DIRECTIONAL les requêtes
+ * sont créées une seule fois par maillage puis seulement redémarrées avec MPI_Startall.
+ * En mode LBM_EXCHANGE_DIRECTIONAL seules les populations qui entrent dans le domaine
+ * voisin sont échangées (3 par maille sur les côtés, 1 pour les coins), les autres
+ * populations des mailles fantômes ne sont propagées que vers d'autres mailles fantômes
+ * (uniquement pour les pas classic et overlap, voir lbm_comm_use_directional()).
+ * En mode LBM_EXCHANGE_SHARED les mailles des voisins du même noeud sont lues directement
+ * dans leur fenêtre partagée par lbm_comm_ghost_exchange_wait(), après une synchronisation
+ * par messages vides, seuls les voisins des autres noeuds reçoivent des messages.
+ * En mode LBM_EXCHANGE_RMA le bord est écrit par MPI_Put dans les mailles fantômes des
+ * voisins, synchronisé par post/start/complete/wait sur le groupe des voisins.
+ * @param comm Découpage du domaine, les requêtes sont gardées dans comm->requests.
+ * @param mesh Maillage à échanger.
+**/
+void lbm_comm_ghost_exchange_start( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int slot;
+
+	//errors
+	assert(comm->request_count == 0);
+	assert(mesh->width == comm->width && mesh->height == comm->height);
+
+	//start
+	if (EXCHANGE_MODE == LBM_EXCHANGE_RMA) {
+		comm->request_first = 0;
+		comm->request_count = 0;
+		lbm_comm_rma_start( comm, mesh );
+	} else if (EXCHANGE_MODE == LBM_EXCHANGE_SHARED) {
+		comm->request_first = 0;
+		comm->request_count = lbm_comm_shared_start( comm, mesh );
+	} else if (EXCHANGE_MODE != LBM_EXCHANGE_EXERCISE) {
+		slot = lbm_comm_persistent_slot( comm, mesh );
+		comm->request_first = slot * LBM_COMM_NEIGHBOUR_REQUESTS;
+		comm->request_count = comm->persistent_count[slot];
+		if (comm->request_count > 0)
+			MPI_Startall( comm->request_count, &comm->requests[comm->request_first] );
+	} else {
+		comm->request_first = 0;
+		comm->request_count = lbm_comm_neighbour_requests( comm, mesh, comm->requests, 0 );
+	}
+}
+
+/****************************************************/
+/**
+ * Fait progresser l'échange démarré par lbm_comm_ghost_exchange_start(), à appeler
+ * entre deux phases de calcul.
+ * @return Vrai si l'échange est terminé.
+**/
+int lbm_comm_ghost_exchange_test( lbm_comm_t * comm )
+{
+	int done = 1;
+	//the one-sided epochs are only closed by lbm_comm_ghost_exchange_wait()
+	if (comm->rma_active != MPI_WIN_NULL)
+		return 0;
+	if (comm->request_count > 0)
+		MPI_Testall( comm->request_count, &comm->requests[comm->request_first], &done, MPI_STATUSES_IGNORE );
+	return done;
+}
+
+/****************************************************/
+/**
+ * Termine l'échange démarré par lbm_comm_ghost_exchange_start(). Les requêtes
+ * persistantes redeviennent inactives et restent utilisables. En mode LBM_EXCHANGE_SHARED
+ * c'est ici que les mailles des voisins du noeud sont copiées.
+**/
+void lbm_comm_ghost_exchange_wait( lbm_comm_t * comm )
+{
+	MPI_Waitall( comm->request_count, &comm->requests[comm->request_first], MPI_STATUSES_IGNORE );
+	comm->request_count = 0;
+
+	//close the one-sided epochs, our puts then those of the neighboors
+	if (comm->rma_active != MPI_WIN_NULL)
+	{
+		MPI_Win_complete( comm->rma_active );
+		MPI_Win_wait( comm->rma_active );
+		comm->rma_active = MPI_WIN_NULL;
+	}
+
+	//read the neighboors of the node
+	if (comm->shared_mesh != NULL)
+	{
+		lbm_comm_shared_finish( comm, comm->shared_mesh );
+		comm->shared_mesh = NULL;
+	}
+}
+
+/****************************************************/
+/**
+ * Crée le graphe des 8 voisins (comm->neighbour_communicator) utilisé par
+ * lbm_comm_ghost_exchange_neighbour(). Il est construit au dessus de comm->communicator
+ * sans renuméroter les rangs, les voisins sont listés dans le même ordre que les
+ * échanges de lbm_comm_ghost_exchange_neighbour() et pondérés par le nombre de mailles
+ * échangées.
+ * @param comm Découpage du domaine, nb_x, nb_y, rank_x et rank_y doivent être définis.
+**/
+void lbm_comm_neighbour_graph_init( lbm_comm_t * comm )
+{
+	//vars
+	int dx, dy, rank;
+	int count = 0;
+	int neighbours[8];
+	int weights[8];
+
+	//list neighboors, the sources and destinations are the same
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			rank = lbm_comm_neighbour_rank(comm, dx, dy);
+			if ((dx == 0 && dy == 0) || rank == MPI_PROC_NULL)
+				continue;
+			neighbours[count] = rank;
+			if (dx == 0)
+				weights[count] = comm->width;
+			else if (dy == 0)
+				weights[count] = comm->height;
+			else
+				weights[count] = 1;
+			count++;
+		}
+	}
+
+	MPI_Dist_graph_create_adjacent( comm->communicator, count, neighbours, weights,
+	                                count, neighbours, weights, MPI_INFO_NULL, 0,
+	                                &comm->neighbour_communicator );
+}
+
+/****************************************************/
+/** Libère le graphe créé par lbm_comm_neighbour_graph_init(). **/
+void lbm_comm_neighbour_graph_release( lbm_comm_t * comm )
+{
+	if (comm->neighbour_communicator != MPI_COMM_NULL)
+		MPI_Comm_free( &comm->neighbour_communicator );
+}
+
+/****************************************************/
+/**
+ * Échange les mailles fantômes avec les 8 voisins en un seul appel à
+ * MPI_Neighbor_alltoallw(). Les zones sont les mêmes que lbm_comm_ghost_exchange_start(),
+ * les coins venant des voisins en diagonale, décrites par leur déplacement en octets
+ * depuis le début du maillage. Les zones envoyées et reçues sont disjointes.
+ * @param comm Découpage du domaine avec le graphe de lbm_comm_neighbour_graph_init().
+ * @param mesh Maillage à échanger.
+**/
+void lbm_comm_ghost_exchange_neighbour( lbm_comm_t * comm, lbm_mesh_t * mesh )
+{
+	//vars
+	int dx, dy, x, y;
+	int count = 0;
+	int counts[8];
+	MPI_Aint send_displs[8];
+	MPI_Aint recv_displs[8];
+	MPI_Datatype send_types[8];
+	MPI_Datatype recv_types[8];
+
+	//errors
+	assert(comm->neighbour_communicator != MPI_COMM_NULL);
+	assert(mesh->width == comm->width && mesh->height == comm->height);
+
+	//same order than the graph
+	for ( dy = -1 ; dy <= 1 ; dy++ )
+	{
+		for ( dx = -1 ; dx <= 1 ; dx++ )
+		{
+			if ((dx == 0 && dy == 0) || lbm_comm_neighbour_rank(comm, dx, dy) == MPI_PROC_NULL)
+				continue;
+			counts[count] = 1;
+			recv_types[count] = lbm_comm_overlap_region(comm, dx, dy, 1, &x, &y);
+			recv_displs[count] = (char*)lbm_mesh_get_cell(mesh, x, y) - (char*)mesh->cells;
+			send_types[count] = lbm_comm_overlap_region(comm, dx, dy, 0, &x, &y);
+			send_displs[count] = (char*)lbm_mesh_get_cell(mesh, x, y) - (char*)mesh->cells;
+			count++;
+		}
+	}
+
+	MPI_Neighbor_alltoallw( mesh->cells, counts, send_displs, send_types,
+	                        mesh->cells, counts, recv_displs, recv_types,
+	                        comm->neighbour_communicator );
+}
@@ -17,8 +17,18 @@
 /****************************************************/
 /** Define the rank to be used as master. **/
 #define RANK_MASTER 0
+/** Number of requests of an exchange with the 8 neighboors (one send & one receive each). **/
+#define LBM_COMM_NEIGHBOUR_REQUESTS 16
+/** Number of meshes (cell arrays) for which persistent requests are kept, the step swaps two meshes. **/
+#define LBM_COMM_PERSISTENT_MESHES 2
+/** Tag of the message telling the neighboors of the node that the border cells are ready to be read. **/
+#define LBM_COMM_TAG_SHARED_READY 16
+/** Tag of the message telling the neighboors of the node that their border cells have been read. **/
+#define LBM_COMM_TAG_SHARED_DONE 17
+/** Tag of the messages giving the size of the local mesh to the neighboors. **/
+#define LBM_COMM_TAG_SIZES 18
 /** Maximum number of parallel async operations to track. **/
-#define MAX_ASYNC 16
+#define MAX_ASYNC (LBM_COMM_NEIGHBOUR_REQUESTS * LBM_COMM_PERSISTENT_MESHES)
 
 /****************************************************/
 /**
@@ -49,12 +59,73 @@ typedef struct lbm_comm_t_s
 	int width;
 	/** Height of the local mesh, accounting the ghost cells. **/
 	int height;
-	/** Can be used to store the cartesian communication if using MPI_Cart. **/
+	/**
+	 * Number of ghost layers toward the neighboors (HALO_DEPTH), the sides on the border
+	 * of the global mesh keep a single layer holding the boundary conditions.
+	**/
+	int halo;
+	/** Steps which can still be done with the ghost cells of the last exchange, see lbm_comm_ghost_exchange_ex_select(). **/
+	int halo_steps;
+	/**
+	 * Communicator of the splitting, MPI_COMM_WORLD or the cartesian communicator of
+	 * exercise 7 in which MPI may have renumbered the ranks.
+	**/
 	MPI_Comm communicator;
+	/** Graph of the 8 neighboors used by lbm_comm_ghost_exchange_neighbour(), MPI_COMM_NULL if not used. **/
+	MPI_Comm neighbour_communicator;
 	/** Can be used to store requests. **/
 	MPI_Request requests[MAX_ASYNC];
 	/** Can be used to store data type. **/
 	MPI_Datatype type;
+	/** Type describing a full column of the local mesh (all directions), depend on the mesh layout. **/
+	MPI_Datatype column_type;
+	/** Type describing one cell (all directions), depend on the mesh layout. **/
+	MPI_Datatype cell_type;
+	/** Part of a column exchanged by lbm_comm_ghost_exchange_start(), without the corners coming from the diagonal neighboors. **/
+	MPI_Datatype overlap_column_type;
+	/** Part of a line exchanged by lbm_comm_ghost_exchange_start(), without the corners coming from the diagonal neighboors. **/
+	MPI_Datatype overlap_line_type;
+	/** Corner exchanged with the diagonal neighboors by lbm_comm_ghost_exchange_start() (halo x halo cells). **/
+	MPI_Datatype overlap_corner_type;
+	/**
+	 * Same parts than overlap_*_type and cell_type but only with the populations going
+	 * toward the neighboor (dx,dy), indexed by (dy+1)*3+(dx+1), used by LBM_EXCHANGE_DIRECTIONAL.
+	**/
+	MPI_Datatype directional_types[9];
+	/** Number of requests in flight in requests. **/
+	int request_count;
+	/** Index of the first request in flight in requests. **/
+	int request_first;
+	/**
+	 * Cell arrays for which persistent requests are stored in requests, those of the
+	 * mesh persistent_cells[i] start at requests[i * LBM_COMM_NEIGHBOUR_REQUESTS].
+	**/
+	double * persistent_cells[LBM_COMM_PERSISTENT_MESHES];
+	/** Number of persistent requests of each mesh. **/
+	int persistent_count[LBM_COMM_PERSISTENT_MESHES];
+	/**
+	 * With LBM_EXCHANGE_SHARED, rank in lbm_comm_shared_node() of the neighboor (dx,dy) indexed
+	 * by (dy+1)*3+(dx+1), MPI_UNDEFINED if it is on another node (exchanged by messages).
+	**/
+	int shared_ranks[9];
+	/** Width of the local mesh of the neighboors of the node, indexed like shared_ranks. **/
+	int shared_widths[9];
+	/** Height of the local mesh of the neighboors of the node, indexed like shared_ranks. **/
+	int shared_heights[9];
+	/** Mesh exchanged between lbm_comm_ghost_exchange_start() and lbm_comm_ghost_exchange_wait() with LBM_EXCHANGE_SHARED. **/
+	lbm_mesh_t * shared_mesh;
+	/** With LBM_EXCHANGE_RMA, group of the neighboors for the post/start synchronizations. **/
+	MPI_Group rma_group;
+	/** With LBM_EXCHANGE_RMA, windows exposing the cell arrays rma_cells, created at their first exchange. **/
+	MPI_Win rma_windows[LBM_COMM_PERSISTENT_MESHES];
+	/** Cell arrays for which a window is stored in rma_windows. **/
+	double * rma_cells[LBM_COMM_PERSISTENT_MESHES];
+	/** Ghost cells of the neighboor (dx,dy) facing us in its own mesh, indexed by (dy+1)*3+(dx+1). **/
+	MPI_Datatype rma_types[9];
+	/** Displacement (in doubles) of rma_types in the mesh of the neighboor. **/
+	MPI_Aint rma_displs[9];
+	/** Window of the exchange in flight, MPI_WIN_NULL if none. **/
+	MPI_Win rma_active;
 	/** Can be used to keep track of buffer for non contiguous communications. **/ //TODO what is buffer_send_up?
 	double * buffer_send_up;
 	/** Can be used to keep track of buffer for non contiguous communications. **/
@@ -80,7 +151,73 @@ static inline int lbm_comm_height( lbm_comm_t *comm )
 	return comm->height;
 }
 
+/****************************************************/
+/** Number of ghost layers on the left side of the local mesh. **/
+static inline int lbm_comm_ghost_left( const lbm_comm_t * comm )
+{
+	return (comm->rank_x > 0) ? comm->halo : 1;
+}
+
+/****************************************************/
+/** Number of ghost layers on the right side of the local mesh. **/
+static inline int lbm_comm_ghost_right( const lbm_comm_t * comm )
+{
+	return (comm->rank_x < comm->nb_x - 1) ? comm->halo : 1;
+}
+
+/****************************************************/
+/** Number of ghost layers on the top side of the local mesh. **/
+static inline int lbm_comm_ghost_top( const lbm_comm_t * comm )
+{
+	return (comm->rank_y > 0) ? comm->halo : 1;
+}
+
+/****************************************************/
+/** Number of ghost layers on the bottom side of the local mesh. **/
+static inline int lbm_comm_ghost_bottom( const lbm_comm_t * comm )
+{
+	return (comm->rank_y < comm->nb_y - 1) ? comm->halo : 1;
+}
+
+/****************************************************/
+/**
+ * Position along X of the local cell 0 in the global mesh with its ghost cells (the
+ * boundary conditions are on the columns 0 and MESH_WIDTH + 1).
+**/
+static inline int lbm_comm_origin_x( const lbm_comm_t * comm )
+{
+	return comm->x + 1 - lbm_comm_ghost_left(comm);
+}
+
+/****************************************************/
+/** Same than lbm_comm_origin_x() along Y. **/
+static inline int lbm_comm_origin_y( const lbm_comm_t * comm )
+{
+	return comm->y + 1 - lbm_comm_ghost_top(comm);
+}
+
 /****************************************************/
 void  lbm_comm_print( lbm_comm_t * comm );
+int   lbm_comm_neighbour_rank( const lbm_comm_t * comm, int dx, int dy );
+long  lbm_comm_halo_cells( int nb_x, int nb_y, int total_width, int total_height );
+void  lbm_comm_plan_grid( int comm_size, int total_width, int total_height, int * nb_x, int * nb_y );
+void  lbm_comm_print_grid( const lbm_comm_t * comm, int total_width, int total_height );
+void  lbm_comm_weighted_cuts( const double * costs, int count, int parts, int * cuts );
+void  lbm_comm_init_halo( lbm_comm_t * comm );
+void  lbm_comm_init_mesh_types( lbm_comm_t * comm );
+void  lbm_comm_release_mesh_types( lbm_comm_t * comm );
+void  lbm_comm_aa_halo_exchange( lbm_comm_t * comm, lbm_mesh_t * mesh );
+void  lbm_comm_ghost_exchange_start( lbm_comm_t * comm, lbm_mesh_t * mesh );
+int   lbm_comm_ghost_exchange_test( lbm_comm_t * comm );
+void  lbm_comm_ghost_exchange_wait( lbm_comm_t * comm );
+void  lbm_comm_neighbour_graph_init( lbm_comm_t * comm );
+void  lbm_comm_neighbour_graph_release( lbm_comm_t * comm );
+void  lbm_comm_ghost_exchange_neighbour( lbm_comm_t * comm, lbm_mesh_t * mesh );
+
+/****************************************************/
+MPI_Comm lbm_comm_shared_node( void );
+double * lbm_comm_shared_alloc( size_t size );
+MPI_Win  lbm_comm_shared_window( const double * cells );
+void     lbm_comm_shared_free( double * cells );
 
 #endif
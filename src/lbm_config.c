@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 #include "lbm_config.h"
 
 /****************************************************/
@@ -37,10 +38,256 @@ void lbm_config_set_default(void)
 	//result output file
 	lbm_gbl_config.output_filename = NULL;
 	lbm_gbl_config.write_interval = 50;
+	lbm_gbl_config.output_mode = LBM_OUTPUT_INDEPENDENT;
+	//checkpoints
+	lbm_gbl_config.checkpoint_filename = NULL;
+	lbm_gbl_config.checkpoint_interval = 0;
 	//obstacle
 	lbm_gbl_config.obstacle_filename = NULL;
 	lbm_gbl_config.obstable_scale = 1.0;
 	lbm_gbl_config.obstable_rotate = 0.0;
+	//implementation
+	lbm_gbl_config.step_mode = LBM_STEP_CLASSIC;
+	lbm_gbl_config.mesh_layout = LBM_LAYOUT_AOS;
+	lbm_gbl_config.simd = LBM_SIMD_SCALAR;
+	lbm_gbl_config.exchange = LBM_EXCHANGE_EXERCISE;
+	lbm_gbl_config.halo_depth = 1;
+	lbm_gbl_config.threads = 0;
+	//splitting, the special cells do their action on top of the collision & propagation
+	lbm_gbl_config.balance = LBM_BALANCE_EVEN;
+	lbm_gbl_config.cost_bounce_back = 1.25;
+	lbm_gbl_config.cost_inflow = 1.4;
+	lbm_gbl_config.cost_outflow = 1.3;
+	lbm_gbl_config.rebalance_interval = 0;
+	lbm_gbl_config.rebalance_threshold = 1.1;
+	//profiling
+	lbm_gbl_config.profile_filename = NULL;
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un mode de calcul du pas de temps vers sa valeur.
+ * @param value Nom du mode ('classic', 'fused', 'aa' ou 'overlap').
+**/
+lbm_step_mode_t lbm_config_parse_step_mode(const char * value)
+{
+	if (strcmp(value,"classic") == 0)
+		return LBM_STEP_CLASSIC;
+	else if (strcmp(value,"fused") == 0)
+		return LBM_STEP_FUSED;
+	else if (strcmp(value,"aa") == 0)
+		return LBM_STEP_AA;
+	else if (strcmp(value,"overlap") == 0)
+		return LBM_STEP_OVERLAP;
+
+	//error
+	fprintf(stderr,"Invalid step mode : %s (expect 'classic', 'fused', 'aa' or 'overlap')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un mode de calcul du pas de temps, pour l'affichage.
+**/
+const char * lbm_config_step_mode_name(lbm_step_mode_t mode)
+{
+	switch (mode)
+	{
+		case LBM_STEP_CLASSIC:
+			return "classic";
+		case LBM_STEP_FUSED:
+			return "fused";
+		case LBM_STEP_AA:
+			return "aa";
+		case LBM_STEP_OVERLAP:
+			return "overlap";
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un placement mémoire des mailles vers sa valeur.
+ * @param value Nom du placement ('aos' ou 'soa').
+**/
+lbm_mesh_layout_t lbm_config_parse_mesh_layout(const char * value)
+{
+	if (strcmp(value,"aos") == 0)
+		return LBM_LAYOUT_AOS;
+	else if (strcmp(value,"soa") == 0)
+		return LBM_LAYOUT_SOA;
+
+	//error
+	fprintf(stderr,"Invalid mesh layout : %s (expect 'aos' or 'soa')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un placement mémoire des mailles, pour l'affichage.
+**/
+const char * lbm_config_mesh_layout_name(lbm_mesh_layout_t layout)
+{
+	switch (layout)
+	{
+		case LBM_LAYOUT_AOS:
+			return "aos";
+		case LBM_LAYOUT_SOA:
+			return "soa";
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un jeu d'instructions vers sa valeur.
+ * @param value Nom du jeu d'instructions ('auto', 'scalar', 'avx2' ou 'avx512').
+**/
+lbm_simd_isa_t lbm_config_parse_simd_isa(const char * value)
+{
+	if (strcmp(value,"auto") == 0)
+		return LBM_SIMD_AUTO;
+	else if (strcmp(value,"scalar") == 0)
+		return LBM_SIMD_SCALAR;
+	else if (strcmp(value,"avx2") == 0)
+		return LBM_SIMD_AVX2;
+	else if (strcmp(value,"avx512") == 0)
+		return LBM_SIMD_AVX512;
+
+	//error
+	fprintf(stderr,"Invalid SIMD instruction set : %s (expect 'auto', 'scalar', 'avx2' or 'avx512')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un jeu d'instructions, pour l'affichage.
+**/
+const char * lbm_config_simd_isa_name(lbm_simd_isa_t isa)
+{
+	switch (isa)
+	{
+		case LBM_SIMD_AUTO:
+			return "auto";
+		case LBM_SIMD_SCALAR:
+			return "scalar";
+		case LBM_SIMD_AVX2:
+			return "avx2";
+		case LBM_SIMD_AVX512:
+			return "avx512";
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un mode d'échange des mailles fantômes vers sa valeur.
+ * @param value Nom du mode ('exercise', 'persistent', 'directional', 'shared' ou 'rma').
+**/
+lbm_exchange_mode_t lbm_config_parse_exchange_mode(const char * value)
+{
+	if (strcmp(value,"exercise") == 0)
+		return LBM_EXCHANGE_EXERCISE;
+	else if (strcmp(value,"persistent") == 0)
+		return LBM_EXCHANGE_PERSISTENT;
+	else if (strcmp(value,"directional") == 0)
+		return LBM_EXCHANGE_DIRECTIONAL;
+	else if (strcmp(value,"shared") == 0)
+		return LBM_EXCHANGE_SHARED;
+	else if (strcmp(value,"rma") == 0)
+		return LBM_EXCHANGE_RMA;
+
+	//error
+	fprintf(stderr,"Invalid exchange mode : %s (expect 'exercise', 'persistent', 'directional', 'shared' or 'rma')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un mode d'échange des mailles fantômes, pour l'affichage.
+**/
+const char * lbm_config_exchange_mode_name(lbm_exchange_mode_t mode)
+{
+	switch (mode)
+	{
+		case LBM_EXCHANGE_EXERCISE:
+			return "exercise";
+		case LBM_EXCHANGE_PERSISTENT:
+			return "persistent";
+		case LBM_EXCHANGE_DIRECTIONAL:
+			return "directional";
+		case LBM_EXCHANGE_SHARED:
+			return "shared";
+		case LBM_EXCHANGE_RMA:
+			return "rma";
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un mode de découpage du maillage vers sa valeur.
+ * @param value Nom du mode ('even' ou 'weighted').
+**/
+lbm_balance_mode_t lbm_config_parse_balance_mode(const char * value)
+{
+	if (strcmp(value,"even") == 0)
+		return LBM_BALANCE_EVEN;
+	else if (strcmp(value,"weighted") == 0)
+		return LBM_BALANCE_WEIGHTED;
+
+	//error
+	fprintf(stderr,"Invalid balance mode : %s (expect 'even' or 'weighted')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un mode de découpage du maillage, pour l'affichage.
+**/
+const char * lbm_config_balance_mode_name(lbm_balance_mode_t mode)
+{
+	switch (mode)
+	{
+		case LBM_BALANCE_EVEN:
+			return "even";
+		case LBM_BALANCE_WEIGHTED:
+			return "weighted";
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Conversion du nom d'un mode d'écriture des résultats vers sa valeur.
+ * @param value Nom du mode ('independent' ou 'collective').
+**/
+lbm_output_mode_t lbm_config_parse_output_mode(const char * value)
+{
+	if (strcmp(value,"independent") == 0)
+		return LBM_OUTPUT_INDEPENDENT;
+	else if (strcmp(value,"collective") == 0)
+		return LBM_OUTPUT_COLLECTIVE;
+
+	//error
+	fprintf(stderr,"Invalid output mode : %s (expect 'independent' or 'collective')\n",value);
+	abort();
+}
+
+/****************************************************/
+/**
+ * Nom d'un mode d'écriture des résultats, pour l'affichage.
+**/
+const char * lbm_config_output_mode_name(lbm_output_mode_t mode)
+{
+	switch (mode)
+	{
+		case LBM_OUTPUT_INDEPENDENT:
+			return "independent";
+		case LBM_OUTPUT_COLLECTIVE:
+			return "collective";
+	}
+	return "unknown";
 }
 
 /****************************************************/
@@ -114,6 +361,12 @@ void lbm_config_init(const char * filename)
 			 lbm_gbl_config.relax_parameter = doubleValue;
 		} else if (sscanf(buffer,"write_interval = %d\n",&intValue) == 1) {
 			 lbm_gbl_config.write_interval = intValue;
+		} else if (sscanf(buffer,"output_mode = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.output_mode = lbm_config_parse_output_mode(buffer2);
+		} else if (sscanf(buffer,"checkpoint_filename = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.checkpoint_filename = strdup(buffer2);
+		} else if (sscanf(buffer,"checkpoint_interval = %d\n",&intValue) == 1) {
+			 lbm_gbl_config.checkpoint_interval = intValue;
 		} else if (sscanf(buffer,"output_filename = %s\n",buffer2) == 1) {
 			 lbm_gbl_config.output_filename = strdup(buffer2);
 		} else if (sscanf(buffer,"obstacle_filename = %s\n",buffer2) == 1) {
@@ -122,6 +375,32 @@ void lbm_config_init(const char * filename)
 			 lbm_gbl_config.obstable_scale = doubleValue;
 		} else if (sscanf(buffer,"obstacle_rotate = %lf\n",&doubleValue) == 1) {
 			 lbm_gbl_config.obstable_rotate = doubleValue;
+		} else if (sscanf(buffer,"step_mode = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.step_mode = lbm_config_parse_step_mode(buffer2);
+		} else if (sscanf(buffer,"mesh_layout = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.mesh_layout = lbm_config_parse_mesh_layout(buffer2);
+		} else if (sscanf(buffer,"simd = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.simd = lbm_config_parse_simd_isa(buffer2);
+		} else if (sscanf(buffer,"exchange = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.exchange = lbm_config_parse_exchange_mode(buffer2);
+		} else if (sscanf(buffer,"halo_depth = %d\n",&intValue) == 1) {
+			 lbm_gbl_config.halo_depth = intValue;
+		} else if (sscanf(buffer,"threads = %d\n",&intValue) == 1) {
+			 lbm_gbl_config.threads = intValue;
+		} else if (sscanf(buffer,"balance = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.balance = lbm_config_parse_balance_mode(buffer2);
+		} else if (sscanf(buffer,"cost_bounce_back = %lf\n",&doubleValue) == 1) {
+			 lbm_gbl_config.cost_bounce_back = doubleValue;
+		} else if (sscanf(buffer,"cost_inflow = %lf\n",&doubleValue) == 1) {
+			 lbm_gbl_config.cost_inflow = doubleValue;
+		} else if (sscanf(buffer,"cost_outflow = %lf\n",&doubleValue) == 1) {
+			 lbm_gbl_config.cost_outflow = doubleValue;
+		} else if (sscanf(buffer,"rebalance_interval = %d\n",&intValue) == 1) {
+			 lbm_gbl_config.rebalance_interval = intValue;
+		} else if (sscanf(buffer,"rebalance_threshold = %lf\n",&doubleValue) == 1) {
+			 lbm_gbl_config.rebalance_threshold = doubleValue;
+		} else if (sscanf(buffer,"profile_filename = %s\n",buffer2) == 1) {
+			 lbm_gbl_config.profile_filename = strdup(buffer2);
 		} else {
 			fprintf(stderr,"Invalid config option line %d : %s\n",line,buffer);
 			abort();
@@ -138,6 +417,34 @@ void lbm_config_init(const char * filename)
 	lbm_config_drived_parameters();
 }
 
+/****************************************************/
+/**
+ * Apply a weak scaling factor : the surface of the mesh is multiplied by factor.
+ * The width is rounded up to a multiple of comm_size and the height down so the
+ * splitting stay regular, then the obstacle is replaced at the same relative place.
+**/
+void lbm_config_apply_scaling(int factor, int comm_size)
+{
+	//nothing to do
+	if (factor <= 1)
+		return;
+
+	//apply
+	double scale = sqrt((double)factor);
+	MESH_WIDTH = (double)MESH_WIDTH * scale;
+	MESH_HEIGHT = (double)MESH_HEIGHT * scale;
+
+	//make multiple of
+	if (MESH_WIDTH % comm_size != 0)
+		MESH_WIDTH += comm_size - MESH_WIDTH % comm_size;
+	if (MESH_HEIGHT % comm_size != 0)
+		MESH_HEIGHT -= MESH_HEIGHT % comm_size;
+
+	//recompute obstable
+	lbm_gbl_config.obstacle_r = (lbm_gbl_config.height / 10.0 + 1.0);
+	lbm_gbl_config.obstacle_y = (lbm_gbl_config.height / 2.0 + 3.0);
+}
+
 /****************************************************/
 /**
  * Nettotage de la mémoire dynamique de la config.
@@ -145,6 +452,8 @@ void lbm_config_init(const char * filename)
 void lbm_config_cleanup(void)
 {
 	free((void*)lbm_gbl_config.output_filename);
+	free((void*)lbm_gbl_config.profile_filename);
+	free((void*)lbm_gbl_config.checkpoint_filename);
 }
 
 /****************************************************/
@@ -169,10 +478,30 @@ void lbm_config_print(void)
 	//results
 	printf("%-20s = %s\n","output_filename",lbm_gbl_config.output_filename);
 	printf("%-20s = %d\n","write_interval",lbm_gbl_config.write_interval);
+	printf("%-20s = %s\n","output_mode",lbm_config_output_mode_name(lbm_gbl_config.output_mode));
+	//checkpoints
+	printf("%-20s = %s\n","checkpoint_filename",lbm_gbl_config.checkpoint_filename);
+	printf("%-20s = %d\n","checkpoint_interval",lbm_gbl_config.checkpoint_interval);
 	//obstacle
 	printf("%-20s = %s\n","obstacle_filename",lbm_gbl_config.obstacle_filename);
 	printf("%-20s = %lf\n","obstable_scale",lbm_gbl_config.obstable_scale);
 	printf("%-20s = %lf\n","obstable_rotate",lbm_gbl_config.obstable_rotate);
+	//implementation
+	printf("%-20s = %s\n","step_mode",lbm_config_step_mode_name(lbm_gbl_config.step_mode));
+	printf("%-20s = %s\n","mesh_layout",lbm_config_mesh_layout_name(lbm_gbl_config.mesh_layout));
+	printf("%-20s = %s\n","simd",lbm_config_simd_isa_name(lbm_gbl_config.simd));
+	printf("%-20s = %s\n","exchange",lbm_config_exchange_mode_name(lbm_gbl_config.exchange));
+	printf("%-20s = %d\n","halo_depth",lbm_gbl_config.halo_depth);
+	printf("%-20s = %d\n","threads",lbm_gbl_config.threads);
+	//splitting
+	printf("%-20s = %s\n","balance",lbm_config_balance_mode_name(lbm_gbl_config.balance));
+	printf("%-20s = %lf\n","cost_bounce_back",lbm_gbl_config.cost_bounce_back);
+	printf("%-20s = %lf\n","cost_inflow",lbm_gbl_config.cost_inflow);
+	printf("%-20s = %lf\n","cost_outflow",lbm_gbl_config.cost_outflow);
+	printf("%-20s = %d\n","rebalance_interval",lbm_gbl_config.rebalance_interval);
+	printf("%-20s = %lf\n","rebalance_threshold",lbm_gbl_config.rebalance_threshold);
+	//profiling
+	printf("%-20s = %s\n","profile_filename",lbm_gbl_config.profile_filename);
 	printf("------------ Derived parameters --------------\n");
 	printf("%-20s = %lf\n","kinetic_viscosity",lbm_gbl_config.kinetic_viscosity);
 	printf("%-20s = %lf\n","relax_parameter",lbm_gbl_config.relax_parameter);
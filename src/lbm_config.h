@@ -36,6 +36,116 @@
 #define RESULT_MAGICK 0x12345
 #define WRITE_BUFFER_ENTRIES 4096
 #define WRITE_STEP_INTERVAL (lbm_gbl_config.write_interval)
+//independent or collective writes of the frames
+#define OUTPUT_MODE (lbm_gbl_config.output_mode)
+//checkpoints of the populations to restart the run
+#define CHECKPOINT_FILENAME (lbm_gbl_config.checkpoint_filename)
+#define CHECKPOINT_INTERVAL (lbm_gbl_config.checkpoint_interval)
+//step implementation
+#define STEP_MODE (lbm_gbl_config.step_mode)
+//memory layout of the cells
+#define MESH_LAYOUT (lbm_gbl_config.mesh_layout)
+//instruction set for the collision kernel
+#define SIMD_ISA (lbm_gbl_config.simd)
+//implementation of the ghost cells exchange
+#define EXCHANGE_MODE (lbm_gbl_config.exchange)
+//number of ghost layers toward the neighboors, exchanged every HALO_DEPTH steps
+#define HALO_DEPTH (lbm_gbl_config.halo_depth)
+//placement of the cut lines between the MPI ranks
+#define BALANCE_MODE (lbm_gbl_config.balance)
+//dynamic rebalancing, check every REBALANCE_INTERVAL steps (0 = disabled)
+#define REBALANCE_INTERVAL (lbm_gbl_config.rebalance_interval)
+#define REBALANCE_THRESHOLD (lbm_gbl_config.rebalance_threshold)
+//number of OpenMP threads per MPI rank (0 = keep OpenMP default)
+#define THREADS (lbm_gbl_config.threads)
+//json file receiving the timers report (NULL to disable)
+#define PROFILE_FILENAME (lbm_gbl_config.profile_filename)
+
+/****************************************************/
+/**
+ * Define how the time step is computed.
+**/
+typedef enum lbm_step_mode_e
+{
+	/** Three passes : special cells, collision then propagation. **/
+	LBM_STEP_CLASSIC,
+	/** Single pass applying special cells, collision and propagation cell by cell. **/
+	LBM_STEP_FUSED,
+	/** Single pass, in place AA streaming without temporary mesh. **/
+	LBM_STEP_AA,
+	/** Three passes, border cells first then the inner cells while the ghost cells are exchanged. **/
+	LBM_STEP_OVERLAP
+} lbm_step_mode_t;
+
+/****************************************************/
+/**
+ * Define how the DIRECTIONS values of the cells are placed in memory.
+**/
+typedef enum lbm_mesh_layout_e
+{
+	/** Array of structures : the DIRECTIONS values of a cell are contiguous. **/
+	LBM_LAYOUT_AOS,
+	/** Structure of arrays : one contiguous plane of cells per direction. **/
+	LBM_LAYOUT_SOA
+} lbm_mesh_layout_t;
+
+/****************************************************/
+/**
+ * Define the instruction set used by the collision kernel.
+**/
+typedef enum lbm_simd_isa_e
+{
+	/** Use the best one supported by the CPU. **/
+	LBM_SIMD_AUTO,
+	/** Reference implementation, one cell at a time. Default as the vector kernels use FMA and differ in the last bits. **/
+	LBM_SIMD_SCALAR,
+	/** AVX2 + FMA, 4 cells per instruction. **/
+	LBM_SIMD_AVX2,
+	/** AVX-512F, 8 cells per instruction. **/
+	LBM_SIMD_AVX512
+} lbm_simd_isa_t;
+
+/****************************************************/
+/**
+ * Define how the ghost cells are exchanged between the MPI ranks.
+**/
+typedef enum lbm_exchange_mode_e
+{
+	/** Use the communication scheme of the selected exercise. **/
+	LBM_EXCHANGE_EXERCISE,
+	/** Generic exchange with the 8 neighboors using persistent requests created once. **/
+	LBM_EXCHANGE_PERSISTENT,
+	/** Same than LBM_EXCHANGE_PERSISTENT but only send the populations crossing the faces and corners. **/
+	LBM_EXCHANGE_DIRECTIONAL,
+	/** Cells allocated in MPI shared memory windows, the neighboors on the same node read the ghost cells directly. **/
+	LBM_EXCHANGE_SHARED,
+	/** One-sided MPI_Put of the borders into the ghost cells of the neighboors, synchronized with post/start/complete/wait. **/
+	LBM_EXCHANGE_RMA
+} lbm_exchange_mode_t;
+
+/****************************************************/
+/**
+ * Define how the mesh is split between the MPI ranks.
+**/
+typedef enum lbm_balance_mode_e
+{
+	/** Same number of columns and lines on every rank. **/
+	LBM_BALANCE_EVEN,
+	/** Place the cuts between the columns to balance the cost of the cells (cost_* options). **/
+	LBM_BALANCE_WEIGHTED
+} lbm_balance_mode_t;
+
+/****************************************************/
+/**
+ * Define how the frames are written in the output file.
+**/
+typedef enum lbm_output_mode_e
+{
+	/** Each rank writes its sub-domain with MPI_File_write_at(), the lines of ranks are stored one after the other. **/
+	LBM_OUTPUT_INDEPENDENT,
+	/** Subarray file views and MPI_File_write_at_all(), the frames are stored as a single global column-major array. **/
+	LBM_OUTPUT_COLLECTIVE
+} lbm_output_mode_t;
 
 /****************************************************/
 /**
@@ -60,18 +170,51 @@ typedef struct lbm_config_s
 	//results
 	const char * output_filename;
 	int write_interval;
+	lbm_output_mode_t output_mode;
+	//checkpoints
+	const char * checkpoint_filename;
+	int checkpoint_interval;
 	//obstable
 	const char * obstacle_filename;
 	double obstable_scale;
 	double obstable_rotate;
+	//implementation
+	lbm_step_mode_t step_mode;
+	lbm_mesh_layout_t mesh_layout;
+	lbm_simd_isa_t simd;
+	lbm_exchange_mode_t exchange;
+	int halo_depth;
+	int threads;
+	//splitting, cost of the special cells relative to a fluid cell
+	lbm_balance_mode_t balance;
+	double cost_bounce_back;
+	double cost_inflow;
+	double cost_outflow;
+	int rebalance_interval;
+	double rebalance_threshold;
+	//profiling
+	const char * profile_filename;
 } lbm_config_t;
 
 /****************************************************/
 void lbm_config_init(const char * filename);
 void lbm_config_drived_parameters(void);
+void lbm_config_apply_scaling(int factor, int comm_size);
 void lbm_config_cleanup(void);
 void lbm_config_print(void);
 void lbm_config_set_default(void);
+lbm_step_mode_t lbm_config_parse_step_mode(const char * value);
+const char * lbm_config_step_mode_name(lbm_step_mode_t mode);
+lbm_mesh_layout_t lbm_config_parse_mesh_layout(const char * value);
+const char * lbm_config_mesh_layout_name(lbm_mesh_layout_t layout);
+lbm_simd_isa_t lbm_config_parse_simd_isa(const char * value);
+const char * lbm_config_simd_isa_name(lbm_simd_isa_t isa);
+lbm_exchange_mode_t lbm_config_parse_exchange_mode(const char * value);
+const char * lbm_config_exchange_mode_name(lbm_exchange_mode_t mode);
+lbm_balance_mode_t lbm_config_parse_balance_mode(const char * value);
+const char * lbm_config_balance_mode_name(lbm_balance_mode_t mode);
+lbm_output_mode_t lbm_config_parse_output_mode(const char * value);
+const char * lbm_config_output_mode_name(lbm_output_mode_t mode);
 
 /****************************************************/
 /**
@@ -39,31 +39,36 @@ void lbm_init_velocity_0_density_1(lbm_mesh_t * mesh)
 	assert(mesh != NULL);
 
 	//loop on all cells
+	#pragma omp parallel for private(j,k) schedule(static)
 	for ( i = 0 ; i <  mesh->width ; i++)
 		for ( j = 0 ; j <  mesh->height ; j++)
 			for ( k = 0 ; k < DIRECTIONS ; k++)
-				lbm_mesh_get_cell(mesh, i, j)[k] = equil_weight[k];
+				*lbm_mesh_get_value(mesh, i, j, k) = equil_weight[k];
 }
 
 /****************************************************/
 /**
  * Initialisation de l'obstacle, on bascule les types des mailles associé à CELL_BOUNCE_BACK.
  * Ici l'obstacle est un cercle de centre (OBSTACLE_X,OBSTACLE_Y) et de rayon OBSTACLE_R.
+ * Seuls les types sont modifiés, mesh peut être NULL.
 **/
 void lbm_init_circle_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
 {
 	//vars
 	int i,j;
+	const int origin_x = lbm_comm_origin_x(comm);
+	const int origin_y = lbm_comm_origin_y(comm);
 
 	//loop on nodes
-	for ( i =  comm->x; i < mesh->width + comm->x ; i++)
+	#pragma omp parallel for private(j) schedule(static)
+	for ( i =  origin_x; i < mesh_type->width + origin_x ; i++)
 	{
-		for ( j =  comm->y ; j <  mesh->height + comm->y ; j++)
+		for ( j =  origin_y ; j <  mesh_type->height + origin_y ; j++)
 		{
 			if ( ( (i-OBSTACLE_X) * (i-OBSTACLE_X) ) + ( (j-OBSTACLE_Y) * (j-OBSTACLE_Y) ) <= OBSTACLE_R * OBSTACLE_R )
 			{
 
-				*( lbm_cell_type_t_get_cell( mesh_type , i - comm->x, j - comm->y) ) = CELL_BOUNCE_BACK;
+				*( lbm_cell_type_t_get_cell( mesh_type , i - origin_x, j - origin_y) ) = CELL_BOUNCE_BACK;
 				//for ( k = 0 ; k < DIMENSIONS ; k++)
 				//	mesh[i][j][k] = 0.0;
 			}
@@ -82,27 +87,28 @@ void lbm_init_global_poiseuille_profile(lbm_mesh_t * mesh, lbm_mesh_type_t * mes
 {
 	//vars
 	int i,j,k;
-	Vector v = {0.0,0.0};
 	const double density = 1.0;
 
 	int rank;
 	MPI_Comm_rank(MPI_COMM_WORLD,&rank);
 
 	//apply poiseuil for all nodes except on top/bottom border
+	#pragma omp parallel for private(j,k) schedule(static)
 	for ( i = 0 ; i < mesh->width ; i++)
 	{
+		Vector v = {0.0,0.0};
 		for ( j = 0 ; j < mesh->height ; j++)
 		{
 			for ( k = 0 ; k < DIRECTIONS ; k++)
 			{
 				//compute equilibr.
-				v[0] = lbm_phys_poiseuille(j + comm->y,MESH_HEIGHT);
-				lbm_mesh_get_cell(mesh, i, j)[k] = lbm_phys_equilibrium_profile(v,density,k);
+				v[0] = lbm_phys_poiseuille(j + lbm_comm_origin_y(comm),MESH_HEIGHT);
+				*lbm_mesh_get_value(mesh, i, j, k) = lbm_phys_equilibrium_profile(v,density,k);
 				//mark as standard fluid
 				*( lbm_cell_type_t_get_cell( mesh_type , i, j) ) = CELL_FUILD;
 				//this is a try to init the fluide with null speed except on left interface.
 				//if (i > 1)
-				//	lbm_mesh_get_cell(mesh, i, j)[k] = equil_weight[k];
+				//	*lbm_mesh_get_value(mesh, i, j, k) = equil_weight[k];
 			}
 		}
 	}
@@ -141,7 +147,7 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 			for ( k = 0 ; k < DIRECTIONS ; k++)
 			{
 				//compute equilibr.
-				lbm_mesh_get_cell(mesh, i, 0)[k] = lbm_phys_equilibrium_profile(v,density,k);
+				*lbm_mesh_get_value(mesh, i, 0, k) = lbm_phys_equilibrium_profile(v,density,k);
 				//mark as bounce back
 				*( lbm_cell_type_t_get_cell( mesh_type , i, 0) ) = CELL_BOUNCE_BACK;
 			}
@@ -152,7 +158,7 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 			for ( k = 0 ; k < DIRECTIONS ; k++)
 			{
 				//compute equilibr.
-				lbm_mesh_get_cell(mesh, i, mesh->height - 1)[k] = lbm_phys_equilibrium_profile(v,density,k);
+				*lbm_mesh_get_value(mesh, i, mesh->height - 1, k) = lbm_phys_equilibrium_profile(v,density,k);
 				//mark as bounce back
 				*( lbm_cell_type_t_get_cell( mesh_type , i, mesh->height - 1) ) = CELL_BOUNCE_BACK;
 			}
@@ -161,7 +167,7 @@ void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_c
 /****************************************************/
 /**
  * Initialisation de l'obstacle, on bascule les types des mailles associé à CELL_BOUNCE_BACK.
- * Ici l'obstacle est un cercle de centre (OBSTACLE_X,OBSTACLE_Y) et de rayon OBSTACLE_R.
+ * Ici l'obstacle est lu dans l'image fname. Si mesh est NULL seuls les types sont modifiés.
 **/
 #ifdef HAVE_MAGICK_WAND
 void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm,const char * fname)
@@ -172,6 +178,8 @@ void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, con
 	int obsty;
 	size_t w,h;
 	PixelWand * p;
+	const int origin_x = lbm_comm_origin_x(comm);
+	const int origin_y = lbm_comm_origin_y(comm);
 
 	//open wand image
 	MagickBooleanType status;
@@ -209,18 +217,19 @@ void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, con
 
 	//loop on nodes
 	// 	#pragma omp for private (i,j)
-	for ( i =  comm->x; i < mesh->width + comm->x ; i++)
+	for ( i =  origin_x; i < mesh_type->width + origin_x ; i++)
 	{
-		for ( j =  comm->y ; j <  mesh->height + comm->y ; j++)
+		for ( j =  origin_y ; j <  mesh_type->height + origin_y ; j++)
 		{
 			if ( i > OBSTACLE_X && (i-OBSTACLE_X) < w && (j-obsty) < h && j > obsty)
 			{
 				MagickGetImagePixelColor(image,(i-OBSTACLE_X),h - (j-obsty),p);
 				if (PixelGetRed(p) < 0.8)
 				{
-					*( lbm_cell_type_t_get_cell( mesh_type , i - comm->x, j - comm->y) ) = CELL_BOUNCE_BACK;
-					for ( k = 0 ; k < DIMENSIONS ; k++)
-						lbm_mesh_get_cell(mesh,  i - comm->x, j - comm->y)[k] = equil_weight[k];
+					*( lbm_cell_type_t_get_cell( mesh_type , i - origin_x, j - origin_y) ) = CELL_BOUNCE_BACK;
+					if (mesh != NULL)
+						for ( k = 0 ; k < DIMENSIONS ; k++)
+							*lbm_mesh_get_value(mesh,  i - origin_x, j - origin_y, k) = equil_weight[k];
 				}
 			}
 		}
@@ -250,3 +259,77 @@ void lbm_init_mesh_state(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const l
 		lbm_init_circle_obstacle(mesh,mesh_type, comm);
 	#endif
 }
+
+/****************************************************/
+/**
+ * Place les types des mailles comme lbm_init_mesh_state() sans toucher aux valeurs,
+ * mesh_type doit sortir de lbm_mesh_type_t_init() (toutes les mailles en CELL_FUILD).
+ * Utilisé quand le découpage change (lbm_balance.c).
+**/
+void lbm_init_cell_types(lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	#ifdef HAVE_MAGICK_WAND
+		if (lbm_gbl_config.obstacle_filename == NULL)
+			lbm_init_circle_obstacle(NULL, mesh_type, comm);
+		else
+			lbm_init_image_obstacle(NULL, mesh_type, comm, lbm_gbl_config.obstacle_filename);
+	#else
+		lbm_init_circle_obstacle(NULL, mesh_type, comm);
+	#endif
+}
+
+/****************************************************/
+/**
+ * Coût du calcul d'une maille relatif à une maille de fluide (collision et propagation),
+ * les mailles spéciales font leur action en plus.
+**/
+static double lbm_init_cell_cost(lbm_cell_type_t type)
+{
+	switch (type)
+	{
+		case CELL_FUILD:
+			return 1.0;
+		case CELL_BOUNCE_BACK:
+			return lbm_gbl_config.cost_bounce_back;
+		case CELL_LEFT_IN:
+			return lbm_gbl_config.cost_inflow;
+		case CELL_RIGHT_OUT:
+			return lbm_gbl_config.cost_outflow;
+	}
+	return 1.0;
+}
+
+/****************************************************/
+/**
+ * Calcule le coût de chaque colonne du maillage global à partir des types des mailles
+ * tels que les place lbm_init_mesh_state(), pour placer les coupes entre les processus.
+ * Tous les rangs font le calcul, il ne demande que la grille des types du maillage global.
+ * @param costs Tableau de total_width valeurs recevant le coût des colonnes (sans les mailles fantômes).
+**/
+void lbm_init_column_costs(double * costs, int total_width, int total_height)
+{
+	//vars
+	int i,j;
+	lbm_mesh_type_t mesh_type;
+	lbm_comm_t comm;
+
+	//the global mesh seen as a single domain with its ghost cells
+	comm.nb_x = comm.nb_y = 1;
+	comm.rank_x = comm.rank_y = 0;
+	comm.x = comm.y = 0;
+	comm.width = total_width + 2;
+	comm.height = total_height + 2;
+	lbm_mesh_type_t_init( &mesh_type, comm.width, comm.height );
+	lbm_init_cell_types( &mesh_type, &comm );
+
+	//sum
+	for ( i = 0 ; i < total_width ; i++)
+	{
+		costs[i] = 0.0;
+		for ( j = 1 ; j <= total_height ; j++)
+			costs[i] += lbm_init_cell_cost(*lbm_cell_type_t_get_cell(&mesh_type, i + 1, j));
+	}
+
+	//free
+	lbm_mesh_type_t_release( &mesh_type );
+}
@@ -20,6 +20,8 @@ void lbm_init_circle_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, co
 void lbm_init_global_poiseuille_profile(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type,const lbm_comm_t * comm);
 void lbm_init_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
 void lbm_init_mesh_state(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_init_cell_types(lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_init_column_costs(double * costs, int total_width, int total_height);
 void lbm_init_image_obstacle(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm,const char * fname);
 
 #endif //LBM_INIT_H
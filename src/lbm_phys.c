@@ -9,10 +9,15 @@
 /****************************************************/
 #include <assert.h>
 #include <stdlib.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 #include "lbm_config.h"
 #include "lbm_struct.h"
 #include "lbm_phys.h"
 #include "lbm_comm.h"
+#include "lbm_simd.h"
+#include "lbm_timers.h"
 
 /****************************************************/
 /**
@@ -174,6 +179,41 @@ void lbm_phys_cell_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell
 	}
 }
 
+/****************************************************/
+/**
+ * Applique lbm_phys_cell_collision() sur count mailles consécutives, c'est le noyau de
+ * référence (scalaire) de lbm_simd_collision_cells().
+ * Les mailles sont séparées de *_cell_stride doubles et les directions d'une maille
+ * de *_direction_stride doubles.
+**/
+void lbm_phys_cells_collision(double * cells_out, int out_cell_stride, int out_direction_stride,
+                              const double * cells_in, int in_cell_stride, int in_direction_stride,
+                              int count)
+{
+	//vars
+	int c,k;
+	double cell_in[DIRECTIONS];
+	double cell_out[DIRECTIONS];
+
+	//AoS, nothing to reorder
+	if (in_direction_stride == 1 && out_direction_stride == 1)
+	{
+		for ( c = 0 ; c < count ; c++ )
+			lbm_phys_cell_collision(cells_out + c * out_cell_stride, (lbm_mesh_cell_t)(cells_in + c * in_cell_stride));
+		return;
+	}
+
+	//loop on cells
+	for ( c = 0 ; c < count ; c++ )
+	{
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+			cell_in[k] = cells_in[c * in_cell_stride + k * in_direction_stride];
+		lbm_phys_cell_collision(cell_out, cell_in);
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+			cells_out[c * out_cell_stride + k * out_direction_stride] = cell_out[k];
+	}
+}
+
 /****************************************************/
 /**
  * Applique une reflexion sur les différentes directions pour simuler la présence d'un solide.
@@ -279,24 +319,48 @@ void lbm_phys_outflow_zou_he_const_density(lbm_mesh_cell_t cell)
 }
 
 /****************************************************/
-void lbm_phys_special_cells_one_cell(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm,int i,int j)
+/**
+ * Applique l'action spéciale d'une maille (réflexion, Zou/He) sur une copie locale de ses valeurs.
+ * @param mesh Maillage d'origine de la cellule (pour avoir la hauteur).
+ * @param type Type de la maille.
+ * @param cell Copie locale des DIRECTIONS densités microscopiques.
+ * @param id_y Position absolue en y de la cellule.
+**/
+static inline void lbm_phys_special_cell_apply(const lbm_mesh_t * mesh, lbm_cell_type_t type, lbm_mesh_cell_t cell, int id_y)
 {
-	switch (*( lbm_cell_type_t_get_cell( mesh_type , i, j) ))
+	switch (type)
 	{
 		case CELL_FUILD:
 			break;
 		case CELL_BOUNCE_BACK:
-			lbm_phys_bounce_back(lbm_mesh_get_cell(mesh, i, j));
+			lbm_phys_bounce_back(cell);
 			break;
 		case CELL_LEFT_IN:
-			lbm_phys_inflow_zou_he_poiseuille_distr(mesh, lbm_mesh_get_cell(mesh, i, j) ,j + comm->y);
+			lbm_phys_inflow_zou_he_poiseuille_distr(mesh, cell, id_y);
 			break;
 		case CELL_RIGHT_OUT:
-			lbm_phys_outflow_zou_he_const_density(lbm_mesh_get_cell(mesh, i, j));
+			lbm_phys_outflow_zou_he_const_density(cell);
 			break;
 	}
 }
 
+/****************************************************/
+void lbm_phys_special_cells_one_cell(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm,int i,int j)
+{
+	//vars
+	lbm_cell_type_t type = *( lbm_cell_type_t_get_cell( mesh_type , i, j) );
+	double cell[DIRECTIONS];
+
+	//nothing to do
+	if (type == CELL_FUILD)
+		return;
+
+	//apply
+	lbm_mesh_load_cell(mesh, i, j, cell);
+	lbm_phys_special_cell_apply(mesh, type, cell, j + lbm_comm_origin_y(comm));
+	lbm_mesh_store_cell(mesh, i, j, cell);
+}
+
 /****************************************************/
 /**
  * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
@@ -305,52 +369,84 @@ void lbm_phys_special_cells(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, cons
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
 	//loop on all inner cells
+	#pragma omp parallel for private(j) schedule(static)
 	for( i = 0 ; i < mesh->width ; i++ )
 		for( j = 0 ; j < mesh->height  ; j++)
 			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_SPECIAL_CELLS, timer);
 }
 
 /****************************************************/
 /**
- * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
+ * Applique les actions spéciales sur les mailles internes, c'est à dire à au moins depth
+ * mailles du bord du maillage local. Complète lbm_phys_special_cells_border().
 **/
-void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm, int depth)
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
 	//loop on all inner cells
-	for( i = 1 ; i < mesh->width - 1 ; i++ )
-		for( j = 1 ; j < mesh->height - 1 ; j++)
+	#pragma omp parallel for private(j) schedule(static)
+	for( i = depth ; i < mesh->width - depth ; i++ )
+		for( j = depth ; j < mesh->height - depth ; j++)
 			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_SPECIAL_CELLS, timer);
 }
 
 /****************************************************/
 /**
- * Applique les actions spéciale liée aux conditions de bords ou au réflexions sur l'obstacle.
+ * Applique les actions spéciales sur les depth premières lignes et colonnes de chaque
+ * bord du maillage local (mailles fantômes comprises), chaque maille n'est traitée qu'une fois.
 **/
-void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm, int depth)
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
-	//top
-	for ( i = 0 ; i < mesh->width; i++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,0);
+	//left & right columns
+	for ( i = 0 ; i < depth ; i++)
+	{
+		for ( j = 0 ; j < mesh->height ; j++)
+		{
+			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,mesh->width - 1 - i,j);
+		}
+	}
 
-	//bottom
-	for ( i = 0 ; i < mesh->width; i++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,mesh->height - 1);
+	//top & bottom lines without the corners
+	for ( i = depth ; i < mesh->width - depth ; i++)
+	{
+		for ( j = 0 ; j < depth ; j++)
+		{
+			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,j);
+			lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,i,mesh->height - 1 - j);
+		}
+	}
 
-	//left
-	for ( j = 0 ; j < mesh->height ; j++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,0,j);
+	//timer
+	lbm_timer_stop(LBM_TIMER_SPECIAL_CELLS, timer);
+}
 
-	//right
-	for ( j = 0 ; j < mesh->height ; j++)
-		lbm_phys_special_cells_one_cell(mesh,mesh_type,comm,mesh->width - 1,j);
+/****************************************************/
+/**
+ * Calcule la collision de count cellules consécutives de la colonne i en commençant
+ * par la ligne j avec le noyau sélectionné par lbm_simd_select().
+**/
+static inline void lbm_phys_collision_cells(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in,int i,int j,int count)
+{
+	lbm_simd_collision_cells(lbm_mesh_get_cell(mesh_out, i, j), mesh_out->cell_stride, mesh_out->direction_stride,
+	                         lbm_mesh_get_cell(mesh_in, i, j), mesh_in->cell_stride, mesh_in->direction_stride,
+	                         count);
 }
 
 /****************************************************/
@@ -361,7 +457,8 @@ void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_typ
 void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 {
 	//vars
-	int i,j;
+	int i;
+	double timer = lbm_timer_start();
 
 	//errors
 	assert(mesh_in->width == mesh_out->width);
@@ -369,61 +466,69 @@ void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 
 	//loop on all inner cells
 	//to avoid reflexion of first shock wave : i = 1
+	#pragma omp parallel for schedule(static)
 	for( i = 0 ; i < mesh_in->width ; i++ )
-		for( j = 0 ; j < mesh_in->height ; j++)
-			lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j));
+		lbm_phys_collision_cells(mesh_out, mesh_in, i, 0, mesh_in->height);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLISION, timer);
 }
 
 /****************************************************/
 /**
- * Calcule les collision sur chacune des cellules.
- * @param mesh Maillage sur lequel appliquer le calcule.
+ * Calcule les collisions des mailles à au moins depth mailles du bord du maillage local.
+ * Complète lbm_phys_collision_border().
 **/
-void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
+void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth)
 {
 	//vars
-	int i,j;
+	int i;
+	double timer = lbm_timer_start();
 
 	//errors
 	assert(mesh_in->width == mesh_out->width);
 	assert(mesh_in->height == mesh_out->height);
 
 	//loop on all inner cells
-	//to avoid reflexion of first shock wave : i = 1
-	for( i = 1 ; i < mesh_in->width - 1 ; i++ )
-		for( j = 1 ; j < mesh_in->height - 1 ; j++)
-			lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, j),lbm_mesh_get_cell(mesh_in, i, j));
+	#pragma omp parallel for schedule(static)
+	for( i = depth ; i < mesh_in->width - depth ; i++ )
+		lbm_phys_collision_cells(mesh_out, mesh_in, i, depth, mesh_in->height - 2 * depth);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLISION, timer);
 }
 
 /****************************************************/
 /**
- * Calcule les collision sur chacune des cellules.
- * @param mesh Maillage sur lequel appliquer le calcule.
+ * Calcule les collisions des depth premières lignes et colonnes de chaque bord du
+ * maillage local (mailles fantômes comprises).
 **/
-void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
+void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth)
 {
 	//vars
-	int i,j;
+	int i;
+	double timer = lbm_timer_start();
 
 	//errors
 	assert(mesh_in->width == mesh_out->width);
 	assert(mesh_in->height == mesh_out->height);
 
-	//top
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, 0),lbm_mesh_get_cell(mesh_in, i, 0));
-
-	//bottom
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, i, mesh_out->height - 1),lbm_mesh_get_cell(mesh_in, i, mesh_out->height - 1));
+	//left & right columns
+	for ( i = 0 ; i < depth ; i++)
+	{
+		lbm_phys_collision_cells(mesh_out, mesh_in, i, 0, mesh_out->height);
+		lbm_phys_collision_cells(mesh_out, mesh_in, mesh_out->width - 1 - i, 0, mesh_out->height);
+	}
 
-	//left
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, 0, j),lbm_mesh_get_cell(mesh_in, 0, j));
+	//top & bottom lines without the corners
+	for ( i = depth ; i < mesh_out->width - depth ; i++)
+	{
+		lbm_phys_collision_cells(mesh_out, mesh_in, i, 0, depth);
+		lbm_phys_collision_cells(mesh_out, mesh_in, i, mesh_out->height - depth, depth);
+	}
 
-	//right
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_cell_collision(lbm_mesh_get_cell(mesh_out, mesh_out->width - 1, j),lbm_mesh_get_cell(mesh_in, mesh_out->width - 1, j));
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLISION, timer);
 }
 
 /****************************************************/
@@ -431,6 +536,8 @@ void lbm_phys_propagation_one_cell(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh
 {
 	int k;
 	int ii,jj;
+	const double * cell_in = lbm_mesh_get_cell(mesh_in, i, j);
+	const int direction_stride = mesh_in->direction_stride;
 
 	//for all direction
 	for ( k  = 0 ; k < DIRECTIONS ; k++)
@@ -440,7 +547,7 @@ void lbm_phys_propagation_one_cell(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh
 		jj = (j + direction_matrix[k][1]);
 		//propagate to neighboor nodes
 		if ((ii >= 0 && ii < mesh_out->width) && (jj >= 0 && jj < mesh_out->height))
-			lbm_mesh_get_cell(mesh_out, ii, jj)[k] = lbm_mesh_get_cell(mesh_in, i, j)[k];
+			lbm_mesh_get_cell(mesh_out, ii, jj)[k * direction_stride] = cell_in[k * direction_stride];
 	}
 }
 
@@ -454,51 +561,420 @@ void lbm_phys_propagation(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
-	//loop on all cells
+	//loop on all cells, each destination value is written by a single source cell
+	#pragma omp parallel for private(j) schedule(static)
 	for ( i = 0 ; i < mesh_out->width; i++)
 		for ( j = 0 ; j < mesh_out->height ; j++)
 			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_PROPAGATION, timer);
 }
 
 /****************************************************/
 /**
- * lbm_phys_propagation des densité vers les maillse voisines.
+ * Propagation depuis les mailles à au moins depth mailles du bord du maillage local.
+ * Complète lbm_phys_propagation_border().
  * @param mesh_out Maillage de sortie.
  * @param mesh_in Maillage d'entrée (ne doivent pas être les mêmes).
 **/
-void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
+void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth)
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
 	//loop on all cells
-	for ( i = 1 ; i < mesh_out->width - 1; i++)
-		for ( j = 1 ; j < mesh_out->height - 1; j++)
+	#pragma omp parallel for private(j) schedule(static)
+	for ( i = depth ; i < mesh_out->width - depth; i++)
+		for ( j = depth ; j < mesh_out->height - depth; j++)
 			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_PROPAGATION, timer);
 }
 
 /****************************************************/
 /**
- * lbm_phys_propagation des densité vers les maillse voisines.
+ * Propagation depuis les depth premières lignes et colonnes de chaque bord du maillage
+ * local (mailles fantômes comprises).
  * @param mesh_out Maillage de sortie.
  * @param mesh_in Maillage d'entrée (ne doivent pas être les mêmes).
 **/
-void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in)
+void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth)
 {
 	//vars
 	int i,j;
+	double timer = lbm_timer_start();
 
-	//loop on all cells
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,0);
+	//left & right columns
+	for ( i = 0 ; i < depth ; i++)
+	{
+		for ( j = 0 ; j < mesh_out->height ; j++)
+		{
+			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
+			lbm_phys_propagation_one_cell(mesh_out,mesh_in,mesh_out->width - 1 - i,j);
+		}
+	}
 
-	for ( i = 0 ; i < mesh_out->width; i++)
-		lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,mesh_out->height - 1);
+	//top & bottom lines without the corners
+	for ( i = depth ; i < mesh_out->width - depth ; i++)
+	{
+		for ( j = 0 ; j < depth ; j++)
+		{
+			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,j);
+			lbm_phys_propagation_one_cell(mesh_out,mesh_in,i,mesh_out->height - 1 - j);
+		}
+	}
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_PROPAGATION, timer);
+}
+
+/****************************************************/
+/**
+ * Retourne les colonnes avant et après collision du thread courant, allouées une fois
+ * pour toutes avec le maillage (voir lbm_mesh_init()).
+**/
+static inline double * lbm_phys_thread_columns(const lbm_mesh_t * mesh)
+{
+	//vars
+	int thread = 0;
+
+	#ifdef _OPENMP
+		thread = omp_get_thread_num();
+	#endif
+
+	//errors
+	assert(mesh->columns != NULL);
+	assert(thread < mesh->column_threads);
+
+	return mesh->columns + thread * 2 * DIRECTIONS * mesh->height;
+}
+
+/****************************************************/
+/**
+ * Charge la colonne i du maillage d'entrée dans column (direction k de la maille j en
+ * column[k * height + j]) en appliquant les actions spéciales, la collision de toute
+ * la colonne peut ensuite être faite en un seul appel au noyau vectoriel.
+**/
+static inline void lbm_phys_load_column(double * column, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm, int i)
+{
+	//vars
+	int j,k;
+	double cell[DIRECTIONS];
+	const int height = mesh_in->height;
+
+	for ( j = 0 ; j < height ; j++ )
+	{
+		lbm_mesh_load_cell(mesh_in, i, j, cell);
+		lbm_phys_special_cell_apply(mesh_in, *lbm_cell_type_t_get_cell(mesh_type, i, j), cell, j + lbm_comm_origin_y(comm));
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+			column[k * height + j] = cell[k];
+	}
+}
+
+/****************************************************/
+/**
+ * Propagation d'une maille du bord du maillage local pour laquelle il faut vérifier
+ * l'existence des voisins.
+ * @param column_in Colonne après les actions spéciales.
+ * @param column_out Colonne après la collision.
+**/
+static void lbm_phys_stream_border_cell(lbm_mesh_t * mesh_out, const double * column_in, const double * column_out, int i, int j)
+{
+	//vars
+	int k;
+	int ii,jj;
+	const int width = mesh_out->width;
+	const int height = mesh_out->height;
+
+	//propagate to neighboor nodes
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+	{
+		//push to destination
+		ii = i + direction_matrix[k][0];
+		jj = j + direction_matrix[k][1];
+		if (ii >= 0 && ii < width && jj >= 0 && jj < height)
+			*lbm_mesh_get_value(mesh_out, ii, jj, k) = column_out[k * height + j];
+
+		//nobody push to us on this direction, keep current value
+		ii = i - direction_matrix[k][0];
+		jj = j - direction_matrix[k][1];
+		if (ii < 0 || ii >= width || jj < 0 || jj >= height)
+			*lbm_mesh_get_value(mesh_out, i, j, k) = column_in[k * height + j];
+	}
+}
+
+/****************************************************/
+/**
+ * Calcule en une seule passe les actions spéciales, la collision et la propagation. Chaque
+ * maille d'entrée est lue une seule fois puis ses valeurs après collision sont poussées vers
+ * les mailles voisines du maillage de sortie.
+ * Les directions qui n'ont pas de voisin source (bord du maillage local) reçoivent la valeur
+ * de la maille après les actions spéciales, comme lorsque lbm_phys_propagation ne
+ * touche pas ces valeurs. Le résultat est donc identique à l'enchainement
+ * lbm_phys_special_cells(), lbm_phys_collision(), lbm_phys_propagation().
+ * Les mailles fantômes du maillage d'entrée doivent avoir été échangées avant l'appel.
+ * @param mesh_out Maillage de sortie.
+ * @param mesh_in Maillage d'entrée (ne doivent pas être les mêmes).
+ * @param mesh_type Type des mailles.
+ * @param comm Pour connaitre la position absolue du maillage local.
+**/
+void lbm_phys_collide_and_stream(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	//vars
+	int i,j,k;
+	int offset[DIRECTIONS];
+	const int width = mesh_in->width;
+	const int height = mesh_in->height;
+	double * column_in;
+	double * column_out;
+	double timer = lbm_timer_start();
+
+	//errors
+	assert(mesh_in->width == mesh_out->width);
+	assert(mesh_in->height == mesh_out->height);
+	assert(mesh_in->cells != mesh_out->cells);
+	assert(mesh_in->layout == mesh_out->layout);
+
+	//distance to the destination of each direction
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		offset[k] = ((int)direction_matrix[k][0] * height + (int)direction_matrix[k][1]) * mesh_out->cell_stride + k * mesh_out->direction_stride;
+
+	//each destination value is written by a single source cell so the columns
+	//can be distributed over the threads
+	#pragma omp parallel private(i,j,k,column_in,column_out)
+	{
+	//one column before and after collision for each thread
+	column_in = lbm_phys_thread_columns(mesh_out);
+	column_out = column_in + DIRECTIONS * height;
+
+	#pragma omp for schedule(static)
+	for ( i = 0 ; i < width ; i++ )
+	{
+		//special actions & collision of the whole column
+		lbm_phys_load_column(column_in, mesh_in, mesh_type, comm, i);
+		lbm_simd_collision_cells(column_out, 1, height, column_in, 1, height, height);
+
+		//first and last columns
+		if (i == 0 || i == width - 1)
+		{
+			for ( j = 0 ; j < height ; j++ )
+				lbm_phys_stream_border_cell(mesh_out, column_in, column_out, i, j);
+			continue;
+		}
+
+		//first line
+		lbm_phys_stream_border_cell(mesh_out, column_in, column_out, i, 0);
+
+		//inner cells, all the neighboors exist
+		for ( j = 1 ; j < height - 1 ; j++ )
+		{
+			double * out = lbm_mesh_get_cell(mesh_out, i, j);
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				out[offset[k]] = column_out[k * height + j];
+		}
+
+		//last line
+		lbm_phys_stream_border_cell(mesh_out, column_in, column_out, i, height - 1);
+	}
+	}
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLIDE_STREAM, timer);
+}
+
+/****************************************************/
+/**
+ * Adresse de la valeur k de la maille (x,y) en acceptant les mailles de l'anneau
+ * entourant le maillage local utilisé par le streaming AA.
+**/
+static inline double * lbm_phys_aa_get_value(const lbm_mesh_t * mesh, int x, int y, int k)
+{
+	if (x >= 0 && x < mesh->width && y >= 0 && y < mesh->height)
+		return lbm_mesh_get_value(mesh, x, y, k);
+	else
+		return &lbm_mesh_get_halo_cell(mesh, x, y)[k];
+}
+
+/****************************************************/
+/**
+ * Charge les valeurs d'une maille quel que soit l'état du maillage. Après un pas pair du
+ * streaming AA (aa_swapped) la valeur de la direction k arrivant en (i,j) est encore
+ * rangée dans la direction opposée de la maille source (i,j) - e_k.
+ * @param cell Reçoit les DIRECTIONS valeurs de la maille.
+**/
+void lbm_phys_load_cell(const lbm_mesh_t * mesh, int i, int j, lbm_mesh_cell_t cell)
+{
+	//vars
+	int k;
+
+	//natural state
+	if (mesh->aa_swapped == 0)
+	{
+		lbm_mesh_load_cell(mesh, i, j, cell);
+		return;
+	}
+
+	//gather from the sources
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		cell[k] = *lbm_phys_aa_get_value(mesh, i - direction_matrix[k][0], j - direction_matrix[k][1], opposite_of[k]);
+}
+
+/****************************************************/
+/**
+ * Pas pair du streaming AA : les actions spéciales et la collision de chaque maille sont
+ * calculées en place et le résultat de la direction k est rangé dans la direction
+ * opposée de la même maille, la propagation est donc implicite. Les directions qui n'ont
+ * pas de voisin source reçoivent la valeur après les actions spéciales, elles sont
+ * rangées dans l'anneau aa_halo à la place de la source manquante.
+ * Le maillage doit être dans l'état naturel avec les mailles fantômes échangées.
+ * @param mesh Maillage à mettre à jour en place.
+ * @param mesh_type Type des mailles.
+ * @param comm Pour connaitre la position absolue du maillage local.
+**/
+void lbm_phys_aa_even_step(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	//vars
+	int i,j,k;
+	int ii,jj;
+	const int width = mesh->width;
+	const int height = mesh->height;
+	const int direction_stride = mesh->direction_stride;
+	double * column_in;
+	double * column_out;
+	double timer = lbm_timer_start();
+
+	//errors
+	assert(mesh->aa_halo != NULL);
+	assert(mesh->aa_swapped == 0);
+
+	//each cell only touch its own values and the ring
+	#pragma omp parallel private(i,j,k,ii,jj,column_in,column_out)
+	{
+	//one column before and after collision for each thread
+	column_in = lbm_phys_thread_columns(mesh);
+	column_out = column_in + DIRECTIONS * height;
+
+	#pragma omp for schedule(static)
+	for ( i = 0 ; i < width ; i++ )
+	{
+		//special actions & collision of the whole column
+		lbm_phys_load_column(column_in, mesh, mesh_type, comm, i);
+		lbm_simd_collision_cells(column_out, 1, height, column_in, 1, height, height);
+
+		//store swapped
+		for ( j = 0 ; j < height ; j++ )
+		{
+			double * cell = lbm_mesh_get_cell(mesh, i, j);
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				cell[opposite_of[k] * direction_stride] = column_out[k * height + j];
+		}
+
+		//nobody push to us on these directions, keep current value in place of the source
+		for ( j = 0 ; j < height ; j++ )
+		{
+			//only the cells on the border have missing sources
+			if (i != 0 && i != width - 1 && j != 0 && j != height - 1)
+				continue;
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+			{
+				ii = i - direction_matrix[k][0];
+				jj = j - direction_matrix[k][1];
+				if (ii < 0 || ii >= width || jj < 0 || jj >= height)
+					lbm_mesh_get_halo_cell(mesh, ii, jj)[opposite_of[k]] = column_in[k * height + j];
+			}
+		}
+	}
+	}
+
+	//now swapped
+	mesh->aa_swapped = 1;
+
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLIDE_STREAM, timer);
+}
+
+/****************************************************/
+/**
+ * Pas impair du streaming AA : les valeurs de chaque maille sont lues chez les sources
+ * (là ou le pas pair les a laissées), puis les actions spéciales et la collision sont
+ * appliquées et le résultat est poussé vers les voisins. Chaque maille écrit exactement
+ * aux emplacements qu'elle vient de lire, le calcul peut donc se faire en place. Le
+ * maillage revient dans l'état naturel.
+ * L'anneau aa_halo doit avoir été rempli par les voisins (lbm_comm_aa_halo_exchange()).
+ * @param mesh Maillage à mettre à jour en place.
+ * @param mesh_type Type des mailles.
+ * @param comm Pour connaitre la position absolue du maillage local.
+**/
+void lbm_phys_aa_odd_step(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm)
+{
+	//vars
+	int i,j,k;
+	int offset[DIRECTIONS];
+	double cell[DIRECTIONS];
+	const int width = mesh->width;
+	const int height = mesh->height;
+	double * column_in;
+	double * column_out;
+	double timer = lbm_timer_start();
+
+	//errors
+	assert(mesh->aa_halo != NULL);
+	assert(mesh->aa_swapped != 0);
+
+	//distance to the destination of each direction, the value of direction k is
+	//read at offset[opposite_of[k]]
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		offset[k] = ((int)direction_matrix[k][0] * height + (int)direction_matrix[k][1]) * mesh->cell_stride + k * mesh->direction_stride;
+
+	#pragma omp parallel private(i,j,k,cell,column_in,column_out)
+	{
+	//one column before and after collision for each thread
+	column_in = lbm_phys_thread_columns(mesh);
+	column_out = column_in + DIRECTIONS * height;
+
+	#pragma omp for schedule(static)
+	for ( i = 0 ; i < width ; i++ )
+	{
+		//gather & special actions
+		for ( j = 0 ; j < height ; j++ )
+		{
+			if (i == 0 || i == width - 1 || j == 0 || j == height - 1) {
+				lbm_phys_load_cell(mesh, i, j, cell);
+			} else {
+				const double * in = lbm_mesh_get_cell(mesh, i, j);
+				for ( k = 0 ; k < DIRECTIONS ; k++ )
+					cell[k] = in[offset[opposite_of[k]]];
+			}
+			lbm_phys_special_cell_apply(mesh, *lbm_cell_type_t_get_cell(mesh_type, i, j), cell, j + lbm_comm_origin_y(comm));
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				column_in[k * height + j] = cell[k];
+		}
+
+		//collision of the whole column
+		lbm_simd_collision_cells(column_out, 1, height, column_in, 1, height, height);
+
+		//push, same as lbm_phys_collide_and_stream()
+		for ( j = 0 ; j < height ; j++ )
+		{
+			if (i == 0 || i == width - 1 || j == 0 || j == height - 1) {
+				lbm_phys_stream_border_cell(mesh, column_in, column_out, i, j);
+			} else {
+				double * out = lbm_mesh_get_cell(mesh, i, j);
+				for ( k = 0 ; k < DIRECTIONS ; k++ )
+					out[offset[k]] = column_out[k * height + j];
+			}
+		}
+	}
+	}
 
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_propagation_one_cell(mesh_out,mesh_in,0,j);
+	//back to natural state
+	mesh->aa_swapped = 0;
 
-	for ( j = 0 ; j < mesh_out->height ; j++)
-		lbm_phys_propagation_one_cell(mesh_out,mesh_in,mesh_out->width - 1,j);
+	//timer
+	lbm_timer_stop(LBM_TIMER_COLLIDE_STREAM, timer);
 }
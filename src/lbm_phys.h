@@ -29,7 +29,10 @@ double lbm_phys_poiseuille(int i,int size);
 /****************************************************/
 //collistion
 double lbm_phys_equilibrium_profile(Vector velocity,double density,int direction);
-void lbm_phys_cell_lbm_phys_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell_in);
+void lbm_phys_cell_collision(lbm_mesh_cell_t cell_out,const lbm_mesh_cell_t cell_in);
+void lbm_phys_cells_collision(double * cells_out, int out_cell_stride, int out_direction_stride,
+                              const double * cells_in, int in_cell_stride, int in_direction_stride,
+                              int count);
 
 /****************************************************/
 //limit conditions
@@ -40,13 +43,17 @@ void lbm_phys_outflow_zou_he_const_density(lbm_mesh_cell_t mesh);
 /****************************************************/
 //main functions
 void lbm_phys_special_cells(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
-void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm);
-void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm);
+void lbm_phys_special_cells_inner(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm, int depth);
+void lbm_phys_special_cells_border(lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type, const lbm_comm_t * mesh_comm, int depth);
 void lbm_phys_collision(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
-void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
-void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
+void lbm_phys_collision_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth);
+void lbm_phys_collision_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth);
 void lbm_phys_propagation(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
-void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
-void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in);
+void lbm_phys_propagation_border(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth);
+void lbm_phys_propagation_inner(lbm_mesh_t * mesh_out,const lbm_mesh_t * mesh_in, int depth);
+void lbm_phys_collide_and_stream(lbm_mesh_t * mesh_out, const lbm_mesh_t * mesh_in, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_phys_aa_even_step(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_phys_aa_odd_step(lbm_mesh_t * mesh, const lbm_mesh_type_t * mesh_type, const lbm_comm_t * comm);
+void lbm_phys_load_cell(const lbm_mesh_t * mesh, int i, int j, lbm_mesh_cell_t cell);
 
 #endif
@@ -14,6 +14,22 @@
 #include "lbm_phys.h"
 #include "lbm_save.h"
 
+/****************************************************/
+/**
+ * Fill the header describing how this run stores the frames in the output file.
+**/
+static void lbm_save_setup_file_header(const lbm_comm_t * comm, lbm_file_header_t * header)
+{
+	header->magick      = RESULT_MAGICK;
+	header->mesh_height = MESH_HEIGHT;
+	header->mesh_width  = MESH_WIDTH;
+	header->lines       = comm->nb_y;
+
+	//collective writes store the frames as a single global array
+	if (OUTPUT_MODE == LBM_OUTPUT_COLLECTIVE)
+		header->lines = 1;
+}
+
 /****************************************************/
 /**
  * Save the header of the output file. This header mainly contains the informations about
@@ -24,10 +40,7 @@ void lbm_save_file_header(lbm_comm_t * comm)
 {
 	//setup header values
 	lbm_file_header_t header;
-	header.magick      = RESULT_MAGICK;
-	header.mesh_height = MESH_HEIGHT;
-	header.mesh_width  = MESH_WIDTH;
-	header.lines       = comm->nb_y;
+	lbm_save_setup_file_header(comm, &header);
 
 	//write file
 	//fwrite(&header,sizeof(header),1,fp);
@@ -52,26 +65,83 @@ static inline lbm_file_entry_t * lbm_file_mesh_get_cell( const lbm_file_mesh_t *
 /****************************************************/
 void lbm_save_mesh_init(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm)
 {
+	//vars
+	int i;
+
 	//check
 	assert(file_mesh != NULL);
 	assert(comm != NULL);
 
-	//size
-	file_mesh->width = comm->width - 2;
-	file_mesh->height = comm->height - 2;
+	//size, without the ghost cells
+	file_mesh->first_x = lbm_comm_ghost_left(comm);
+	file_mesh->first_y = lbm_comm_ghost_top(comm);
+	file_mesh->width = comm->width - file_mesh->first_x - lbm_comm_ghost_right(comm);
+	file_mesh->height = comm->height - file_mesh->first_y - lbm_comm_ghost_bottom(comm);
+
+	//allocate, a frame is filled in one buffer while the previous one is written
+	for (i = 0 ; i < LBM_SAVE_BUFFERS ; i++) {
+		file_mesh->buffers[i] = malloc( sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height );
+		file_mesh->requests[i] = MPI_REQUEST_NULL;
+	}
+	file_mesh->current = 0;
+	file_mesh->cells = file_mesh->buffers[0];
+
+	//view of the local cells in a frame, the cells are stored column by column (X is the
+	//slowest dimension) like in the local buffer so the global frame is column-major
+	file_mesh->entry_type = MPI_DATATYPE_NULL;
+	file_mesh->file_type = MPI_DATATYPE_NULL;
+	file_mesh->view_set = 0;
+	if (OUTPUT_MODE == LBM_OUTPUT_COLLECTIVE)
+	{
+		int sizes[2] = {MESH_WIDTH, MESH_HEIGHT};
+		int subsizes[2] = {file_mesh->width, file_mesh->height};
+		int starts[2] = {comm->x, comm->y};
+		MPI_Type_contiguous( sizeof(lbm_file_entry_t), MPI_CHAR, &file_mesh->entry_type );
+		MPI_Type_commit( &file_mesh->entry_type );
+		MPI_Type_create_subarray( 2, sizes, subsizes, starts, MPI_ORDER_C, file_mesh->entry_type, &file_mesh->file_type );
+		MPI_Type_commit( &file_mesh->file_type );
+	}
+}
+
+/****************************************************/
+/**
+ * Wait the end of the background writes of the buffers. Need to be called before closing
+ * the file, the release does it but it is done after the close in main().
+**/
+void lbm_save_mesh_flush(lbm_file_mesh_t * file_mesh)
+{
+	//vars
+	int i;
 
-	//allocate
-	file_mesh->cells = malloc( sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height );
+	//check
+	assert(file_mesh != NULL);
+
+	//wait
+	for (i = 0 ; i < LBM_SAVE_BUFFERS ; i++)
+		if (MPI_Wait(&file_mesh->requests[i], MPI_STATUS_IGNORE) != MPI_SUCCESS)
+			fatal("Fail to fully write data into file !");
 }
 
 /****************************************************/
 void lbm_save_mesh_release(lbm_file_mesh_t * file_mesh)
 {
+	//vars
+	int i;
+
 	//check
 	assert(file_mesh != NULL);
 
+	//the buffers may still be written
+	lbm_save_mesh_flush(file_mesh);
+
 	//free
-	free(file_mesh->cells);
+	for (i = 0 ; i < LBM_SAVE_BUFFERS ; i++)
+		free(file_mesh->buffers[i]);
+	file_mesh->cells = NULL;
+	if (file_mesh->file_type != MPI_DATATYPE_NULL)
+		MPI_Type_free( &file_mesh->file_type );
+	if (file_mesh->entry_type != MPI_DATATYPE_NULL)
+		MPI_Type_free( &file_mesh->entry_type );
 }
 
 /****************************************************/
@@ -82,19 +152,26 @@ void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lb
 	double density;
 	Vector v;
 	double norm;
+	double cell_values[DIRECTIONS];
 
 	//nothing to do
 	if (RESULT_FILENAME == NULL)
 		return;
 
+	//the buffer may still be written by the save before the previous one
+	if (MPI_Wait(&file_mesh->requests[file_mesh->current], MPI_STATUS_IGNORE) != MPI_SUCCESS)
+		fatal("Fail to fully write data into file !");
+
 	//loop on all values
-	for ( i = 1 ; i < mesh->width - 1 ; i++)
+	#pragma omp parallel for private(j,density,v,norm,cell_values) schedule(static)
+	for ( i = file_mesh->first_x ; i < file_mesh->first_x + file_mesh->width ; i++)
 	{
-		for ( j = 1 ; j < mesh->height - 1 ; j++)
+		for ( j = file_mesh->first_y ; j < file_mesh->first_y + file_mesh->height ; j++)
 		{
 			//compute macrospic values
-			density = lbm_phys_cell_density(lbm_mesh_get_cell(mesh, i, j));
-			lbm_phys_cell_velocity(v,lbm_mesh_get_cell(mesh, i, j),density);
+			lbm_phys_load_cell(mesh, i, j, cell_values);
+			density = lbm_phys_cell_density(cell_values);
+			lbm_phys_cell_velocity(v,cell_values,density);
 			norm = sqrt(lbm_phys_vect_norme_2(v,v));
 
 			//fill obstable
@@ -104,7 +181,7 @@ void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lb
 			}
 
 			//fill
-			lbm_file_entry_t * cell = lbm_file_mesh_get_cell(file_mesh, i - 1, j - 1);
+			lbm_file_entry_t * cell = lbm_file_mesh_get_cell(file_mesh, i - file_mesh->first_x, j - file_mesh->first_y);
 			cell->density = density;
 			cell->v = norm;
 		}
@@ -112,32 +189,108 @@ void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lb
 }
 
 /****************************************************/
-void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int rank_x, int rank_y, int write_step)
+/**
+ * Start the write of the buffer filled by lbm_save_fill_mesh() in background and switch
+ * to the other one for the next frame, the write is waited before filling it again. The
+ * place of the sub-domain in the frame comes from comm (x, y).
+**/
+void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int write_step)
 {
 	//checks
 	assert(file_mesh != NULL);
 	assert(comm != NULL);
-	assert(rank_x >= 0 && rank_x < comm->nb_x);
-	assert(rank_y >= 0 && rank_y < comm->nb_y);
 
 	//nothing to write
 	if (RESULT_FILENAME == NULL)
 		return;
 
 	//calc size
-	size_t size = sizeof(lbm_file_entry_t) * file_mesh->width * file_mesh->height;
+	int count = file_mesh->width * file_mesh->height;
+	size_t size = sizeof(lbm_file_entry_t) * count;
+	size_t frame_size = sizeof(lbm_file_entry_t) * MESH_WIDTH * MESH_HEIGHT;
+	MPI_Request * request = &file_mesh->requests[file_mesh->current];
+	int status;
 
-	//calc offset
-	size_t offset = sizeof(lbm_file_header_t) + (comm->nb_x * comm->nb_y * size * write_step) + (rank_y * comm->nb_x + rank_x) * size;
+	//collective write through the view of the frames, MPI can aggregate the sub-domains
+	if (OUTPUT_MODE == LBM_OUTPUT_COLLECTIVE)
+	{
+		//the view cannot change under pending writes, it is set once and the subarray
+		//tiles the file frame by frame so the offset (in visible entries) select the frame
+		if (file_mesh->view_set == 0) {
+			lbm_save_mesh_flush(file_mesh);
+			status = MPI_File_set_view(comm->file_handler, sizeof(lbm_file_header_t),
+			                           file_mesh->entry_type, file_mesh->file_type, "native", MPI_INFO_NULL);
+			if (status != MPI_SUCCESS)
+				fatal("Fail to set the file view of the frames !");
+			file_mesh->view_set = 1;
+		}
+		status = MPI_File_iwrite_at_all(comm->file_handler, (MPI_Offset)count * write_step, file_mesh->cells, count,
+		                                file_mesh->entry_type, request);
+	} else {
+		//calc offset, the blocks of a line of ranks are stored one after the other column
+		//by column, so the sub-domains can have different widths (weighted splitting)
+		size_t offset = sizeof(lbm_file_header_t) + frame_size * write_step
+		              + sizeof(lbm_file_entry_t) * ((size_t)comm->y * MESH_WIDTH + (size_t)comm->x * file_mesh->height);
 
-	//pwrite
-	int status = MPI_File_write_at(comm->file_handler, offset, file_mesh->cells, size, MPI_CHAR, MPI_STATUS_IGNORE);
+		//pwrite
+		status = MPI_File_iwrite_at(comm->file_handler, offset, file_mesh->cells, size, MPI_CHAR, request);
+	}
+
+	//errors
 	if (status != MPI_SUCCESS)
 		fatal("Fail to fully write data into file !");
+
+	//fill the other buffer next time
+	file_mesh->current = (file_mesh->current + 1) % LBM_SAVE_BUFFERS;
+	file_mesh->cells = file_mesh->buffers[file_mesh->current];
+}
+
+/****************************************************/
+/**
+ * On restart, check the header of the output file kept from the previous run. The frames
+ * before the checkpoint were stored with its tiling (lines of ranks), this run must write
+ * the next ones the same way as the header is not rewritten. A file without header (removed
+ * since) gets the one of this run.
+ * @param comm Communication structure to keep track of the MPI_File handler.
+**/
+void lbm_save_check_file_header(lbm_comm_t * comm)
+{
+	//vars
+	int count;
+	MPI_Status status;
+	lbm_file_header_t header, expected;
+
+	//read
+	lbm_save_setup_file_header(comm, &expected);
+	if (MPI_File_read_at(comm->file_handler, 0, &header, sizeof(header), MPI_CHAR, &status) != MPI_SUCCESS)
+		fatal("Failed to read header in output file !");
+	MPI_Get_count(&status, MPI_CHAR, &count);
+
+	//new file
+	if (count == 0) {
+		lbm_save_file_header(comm);
+		return;
+	}
+
+	//check
+	if (count != sizeof(header) || header.magick != RESULT_MAGICK)
+		fatal("Invalid header in the output file to continue !");
+	if (header.mesh_width != expected.mesh_width || header.mesh_height != expected.mesh_height)
+		fatal("The output file to continue has not been written for this mesh size !");
+	if (header.lines != expected.lines) {
+		fprintf(stderr, "The output file stores the frames by %u line(s) of ranks, this run writes %u.\n", header.lines, expected.lines);
+		fatal("Restart with the same number of ranks along Y or with output_mode = collective in both runs !");
+	}
 }
 
 /****************************************************/
-void lbm_open_output_file(lbm_comm_t * comm)
+/**
+ * Open the output file on all the ranks and write its header.
+ * @param comm Communication structure to keep track of the MPI_File handler.
+ * @param restart If true the frames of the previous run are continued, the header is only
+ * checked with lbm_save_check_file_header().
+**/
+void lbm_open_output_file(lbm_comm_t * comm, int restart)
 {
 	//check if empty filename => so noout
 	if (RESULT_FILENAME == NULL)
@@ -148,7 +301,7 @@ void lbm_open_output_file(lbm_comm_t * comm)
 	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
 
 	//open result file
-	int status = MPI_File_open(MPI_COMM_WORLD, RESULT_FILENAME, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &comm->file_handler);
+	int status = MPI_File_open(MPI_COMM_WORLD, RESULT_FILENAME, MPI_MODE_RDWR | MPI_MODE_CREATE, MPI_INFO_NULL, &comm->file_handler);
 
 	//errors
 	if (status != MPI_SUCCESS)
@@ -158,7 +311,9 @@ void lbm_open_output_file(lbm_comm_t * comm)
 	}
 
 	//write header
-	if (rank == 0) {
+	if (rank == 0 && restart) {
+		lbm_save_check_file_header(comm);
+	} else if (rank == 0) {
 		printf("write header \n");
 		lbm_save_file_header(comm);
 	}
@@ -17,21 +17,43 @@
 #include "lbm_struct.h"
 #include "lbm_save.h"
 
+/****************************************************/
+/** Number of buffers of lbm_file_mesh_t, a frame is filled while the previous one is written. **/
+#define LBM_SAVE_BUFFERS 2
+
 /****************************************************/
 typedef struct lbm_file_mesh_s {
+	/** Buffer to fill with the next frame, one of buffers. **/
 	lbm_file_entry_t * cells;
+	/** Frames being filled or written in background. **/
+	lbm_file_entry_t * buffers[LBM_SAVE_BUFFERS];
+	/** Pending write of each buffer, MPI_REQUEST_NULL if the buffer can be filled. **/
+	MPI_Request requests[LBM_SAVE_BUFFERS];
+	/** Index of cells in buffers. **/
+	int current;
 	int width;
 	int height;
+	/** Position of the first real cell in the local mesh (number of ghost layers on the left & top). **/
+	int first_x;
+	int first_y;
+	/** With LBM_OUTPUT_COLLECTIVE, one lbm_file_entry_t, MPI_DATATYPE_NULL otherwise. **/
+	MPI_Datatype entry_type;
+	/** With LBM_OUTPUT_COLLECTIVE, subarray of the local cells in a frame of the global mesh, MPI_DATATYPE_NULL otherwise. **/
+	MPI_Datatype file_type;
+	/** The file view has been set to file_type, done at the first collective write. **/
+	int view_set;
 } lbm_file_mesh_t;
 
 /****************************************************/
 void lbm_save_mesh_init(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm);
 void lbm_save_mesh_release(lbm_file_mesh_t * file_mesh);
+void lbm_save_mesh_flush(lbm_file_mesh_t * file_mesh);
 void lbm_save_fill_mesh(lbm_file_mesh_t * file_mesh, const lbm_mesh_t * mesh, lbm_mesh_type_t * mesh_type);
-void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int rank_x, int rank_y, int write_step);
+void lbm_save_write_mesh(lbm_file_mesh_t * file_mesh, lbm_comm_t * comm, int write_step);
 
 /****************************************************/
 void lbm_save_file_header(lbm_comm_t * comm);
-void lbm_open_output_file(lbm_comm_t * comm);
+void lbm_save_check_file_header(lbm_comm_t * comm);
+void lbm_open_output_file(lbm_comm_t * comm, int restart);
 
 #endif //LBM_SAVE_H
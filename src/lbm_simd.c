@@ -0,0 +1,365 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include "lbm_config.h"
+#include "lbm_struct.h"
+#include "lbm_phys.h"
+#include "lbm_simd.h"
+//intrinsics
+#if defined(__x86_64__) || defined(__i386__)
+	#define HAVE_X86_SIMD
+	#include <immintrin.h>
+#endif
+
+/****************************************************/
+/**
+ * Kernel used by lbm_simd_collision_cells(), setup by lbm_simd_select(). The reference
+ * one is used when no kernel is selected (eg. check_comm).
+**/
+static lbm_simd_collision_kernel_t gbl_collision_kernel = lbm_phys_cells_collision;
+/** Instruction set of the selected kernel. **/
+static lbm_simd_isa_t gbl_collision_isa = LBM_SIMD_SCALAR;
+
+/****************************************************/
+#ifdef HAVE_X86_SIMD
+
+/****************************************************/
+/**
+ * D2Q9 collision of one cell with the constants unrolled. Used for the remaining cells
+ * of the vector kernels. All the multiply-add are explicit fma() to get exactly the
+ * same rounding than the vector lanes.
+**/
+static inline void lbm_simd_collision_d2q9_one_cell(double * out, int out_direction_stride, const double * in, int in_direction_stride, double omega)
+{
+	//vars
+	double f[DIRECTIONS];
+	double feq;
+	int k;
+
+	//load
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		f[k] = in[k * in_direction_stride];
+
+	//macroscopic values
+	const double density = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7] + f[8];
+	const double ux = ((f[1] + f[5] + f[8]) - (f[3] + f[6] + f[7])) / density;
+	const double uy = ((f[2] + f[5] + f[6]) - (f[4] + f[7] + f[8])) / density;
+	const double base = fma(-1.5, fma(uy, uy, ux * ux), 1.0);
+
+	//projection of the velocity on each direction
+	const double p[DIRECTIONS] = { 0.0, ux, uy, -ux, -uy, ux + uy, uy - ux, -ux - uy, ux - uy };
+
+	//relax to equilibrium
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+	{
+		feq = (equil_weight[k] * density) * fma(4.5, p[k] * p[k], fma(3.0, p[k], base));
+		out[k * out_direction_stride] = fma(-omega, f[k] - feq, f[k]);
+	}
+}
+
+/****************************************************/
+/**
+ * Collision of 4 cells at once with AVX2 and FMA.
+**/
+__attribute__((target("avx2,fma")))
+static void lbm_simd_collision_avx2(double * cells_out, int out_cell_stride, int out_direction_stride,
+                                    const double * cells_in, int in_cell_stride, int in_direction_stride,
+                                    int count)
+{
+	//vars
+	int c,k,l;
+	__m256d f[DIRECTIONS];
+	__m256d p[DIRECTIONS];
+	double tmp[4];
+	const double omega = RELAX_PARAMETER;
+	const __m256d v_omega = _mm256_set1_pd(-omega);
+	const __m256d v_one = _mm256_set1_pd(1.0);
+	const __m256d v_m15 = _mm256_set1_pd(-1.5);
+	const __m256d v_3 = _mm256_set1_pd(3.0);
+	const __m256d v_45 = _mm256_set1_pd(4.5);
+	const __m256d v_zero = _mm256_setzero_pd();
+	const __m256d v_sign = _mm256_set1_pd(-0.0);
+	const __m256i in_index = _mm256_set_epi64x(3 * in_cell_stride, 2 * in_cell_stride, in_cell_stride, 0);
+
+	//loop on packs of 4 cells
+	for ( c = 0 ; c + 4 <= count ; c += 4 )
+	{
+		//load
+		const double * in = cells_in + c * in_cell_stride;
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+		{
+			if (in_cell_stride == 1)
+				f[k] = _mm256_loadu_pd(in + k * in_direction_stride);
+			else
+				f[k] = _mm256_i64gather_pd(in + k * in_direction_stride, in_index, 8);
+		}
+
+		//macroscopic values
+		__m256d density = f[0];
+		for ( k = 1 ; k < DIRECTIONS ; k++ )
+			density = _mm256_add_pd(density, f[k]);
+		__m256d ux = _mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(f[1], f[5]), f[8]), _mm256_add_pd(_mm256_add_pd(f[3], f[6]), f[7])), density);
+		__m256d uy = _mm256_div_pd(_mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(f[2], f[5]), f[6]), _mm256_add_pd(_mm256_add_pd(f[4], f[7]), f[8])), density);
+		__m256d base = _mm256_fmadd_pd(v_m15, _mm256_fmadd_pd(uy, uy, _mm256_mul_pd(ux, ux)), v_one);
+
+		//projection of the velocity on each direction
+		p[0] = v_zero;
+		p[1] = ux;
+		p[2] = uy;
+		p[3] = _mm256_xor_pd(ux, v_sign);
+		p[4] = _mm256_xor_pd(uy, v_sign);
+		p[5] = _mm256_add_pd(ux, uy);
+		p[6] = _mm256_sub_pd(uy, ux);
+		p[7] = _mm256_sub_pd(p[3], uy);
+		p[8] = _mm256_sub_pd(ux, uy);
+
+		//relax to equilibrium and store
+		double * out = cells_out + c * out_cell_stride;
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+		{
+			__m256d feq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(equil_weight[k]), density),
+				_mm256_fmadd_pd(v_45, _mm256_mul_pd(p[k], p[k]), _mm256_fmadd_pd(v_3, p[k], base)));
+			__m256d res = _mm256_fmadd_pd(v_omega, _mm256_sub_pd(f[k], feq), f[k]);
+			if (out_cell_stride == 1) {
+				_mm256_storeu_pd(out + k * out_direction_stride, res);
+			} else {
+				_mm256_storeu_pd(tmp, res);
+				for ( l = 0 ; l < 4 ; l++ )
+					out[l * out_cell_stride + k * out_direction_stride] = tmp[l];
+			}
+		}
+	}
+
+	//remaining cells
+	for ( ; c < count ; c++ )
+		lbm_simd_collision_d2q9_one_cell(cells_out + c * out_cell_stride, out_direction_stride, cells_in + c * in_cell_stride, in_direction_stride, omega);
+}
+
+/****************************************************/
+/**
+ * Collision of 8 cells at once with AVX-512.
+**/
+__attribute__((target("avx512f")))
+static void lbm_simd_collision_avx512(double * cells_out, int out_cell_stride, int out_direction_stride,
+                                      const double * cells_in, int in_cell_stride, int in_direction_stride,
+                                      int count)
+{
+	//vars
+	int c,k;
+	__m512d f[DIRECTIONS];
+	__m512d p[DIRECTIONS];
+	const double omega = RELAX_PARAMETER;
+	const __m512d v_omega = _mm512_set1_pd(-omega);
+	const __m512d v_one = _mm512_set1_pd(1.0);
+	const __m512d v_m15 = _mm512_set1_pd(-1.5);
+	const __m512d v_3 = _mm512_set1_pd(3.0);
+	const __m512d v_45 = _mm512_set1_pd(4.5);
+	const __m512d v_zero = _mm512_setzero_pd();
+	const __m512i v_sign = _mm512_castpd_si512(_mm512_set1_pd(-0.0));
+	const __m512i in_index = _mm512_set_epi64(7 * in_cell_stride, 6 * in_cell_stride, 5 * in_cell_stride, 4 * in_cell_stride,
+	                                          3 * in_cell_stride, 2 * in_cell_stride, in_cell_stride, 0);
+	const __m512i out_index = _mm512_set_epi64(7 * out_cell_stride, 6 * out_cell_stride, 5 * out_cell_stride, 4 * out_cell_stride,
+	                                           3 * out_cell_stride, 2 * out_cell_stride, out_cell_stride, 0);
+
+	//loop on packs of 8 cells
+	for ( c = 0 ; c + 8 <= count ; c += 8 )
+	{
+		//load
+		const double * in = cells_in + c * in_cell_stride;
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+		{
+			if (in_cell_stride == 1)
+				f[k] = _mm512_loadu_pd(in + k * in_direction_stride);
+			else
+				f[k] = _mm512_i64gather_pd(in_index, in + k * in_direction_stride, 8);
+		}
+
+		//macroscopic values
+		__m512d density = f[0];
+		for ( k = 1 ; k < DIRECTIONS ; k++ )
+			density = _mm512_add_pd(density, f[k]);
+		__m512d ux = _mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_add_pd(f[1], f[5]), f[8]), _mm512_add_pd(_mm512_add_pd(f[3], f[6]), f[7])), density);
+		__m512d uy = _mm512_div_pd(_mm512_sub_pd(_mm512_add_pd(_mm512_add_pd(f[2], f[5]), f[6]), _mm512_add_pd(_mm512_add_pd(f[4], f[7]), f[8])), density);
+		__m512d base = _mm512_fmadd_pd(v_m15, _mm512_fmadd_pd(uy, uy, _mm512_mul_pd(ux, ux)), v_one);
+
+		//projection of the velocity on each direction
+		p[0] = v_zero;
+		p[1] = ux;
+		p[2] = uy;
+		p[3] = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(ux), v_sign));
+		p[4] = _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(uy), v_sign));
+		p[5] = _mm512_add_pd(ux, uy);
+		p[6] = _mm512_sub_pd(uy, ux);
+		p[7] = _mm512_sub_pd(p[3], uy);
+		p[8] = _mm512_sub_pd(ux, uy);
+
+		//relax to equilibrium and store
+		double * out = cells_out + c * out_cell_stride;
+		for ( k = 0 ; k < DIRECTIONS ; k++ )
+		{
+			__m512d feq = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(equil_weight[k]), density),
+				_mm512_fmadd_pd(v_45, _mm512_mul_pd(p[k], p[k]), _mm512_fmadd_pd(v_3, p[k], base)));
+			__m512d res = _mm512_fmadd_pd(v_omega, _mm512_sub_pd(f[k], feq), f[k]);
+			if (out_cell_stride == 1)
+				_mm512_storeu_pd(out + k * out_direction_stride, res);
+			else
+				_mm512_i64scatter_pd(out + k * out_direction_stride, out_index, res, 8);
+		}
+	}
+
+	//remaining cells
+	for ( ; c < count ; c++ )
+		lbm_simd_collision_d2q9_one_cell(cells_out + c * out_cell_stride, out_direction_stride, cells_in + c * in_cell_stride, in_direction_stride, omega);
+}
+
+#endif //HAVE_X86_SIMD
+
+/****************************************************/
+/**
+ * Check if the current CPU can run the given instruction set.
+**/
+int lbm_simd_supported(lbm_simd_isa_t isa)
+{
+	switch (isa)
+	{
+		case LBM_SIMD_AUTO:
+		case LBM_SIMD_SCALAR:
+			return 1;
+		#ifdef HAVE_X86_SIMD
+		case LBM_SIMD_AVX2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		case LBM_SIMD_AVX512:
+			return __builtin_cpu_supports("avx512f");
+		#else
+		case LBM_SIMD_AVX2:
+		case LBM_SIMD_AVX512:
+			return 0;
+		#endif
+	}
+	return 0;
+}
+
+/****************************************************/
+/**
+ * Number of cells handled by one instruction of the given instruction set.
+**/
+int lbm_simd_cells_per_vector(lbm_simd_isa_t isa)
+{
+	switch (isa)
+	{
+		case LBM_SIMD_AVX2:
+			return 4;
+		case LBM_SIMD_AVX512:
+			return 8;
+		default:
+			return 1;
+	}
+}
+
+/****************************************************/
+/**
+ * Setup the collision kernel without reporting it. With LBM_SIMD_AUTO take the widest
+ * one supported by the CPU, if the requested one is not supported fallback to the
+ * scalar one with a warning.
+ * @param isa The requested instruction set.
+ * @return The selected instruction set.
+**/
+lbm_simd_isa_t lbm_simd_set(lbm_simd_isa_t isa)
+{
+	//vars
+	int rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+	//resolve auto
+	if (isa == LBM_SIMD_AUTO) {
+		if (lbm_simd_supported(LBM_SIMD_AVX512))
+			isa = LBM_SIMD_AVX512;
+		else if (lbm_simd_supported(LBM_SIMD_AVX2))
+			isa = LBM_SIMD_AVX2;
+		else
+			isa = LBM_SIMD_SCALAR;
+	}
+
+	//fallback
+	if (lbm_simd_supported(isa) == 0) {
+		if (rank == 0)
+			warning("Requested SIMD instruction set not supported by the CPU, fallback to scalar !");
+		isa = LBM_SIMD_SCALAR;
+	}
+
+	//setup
+	switch (isa)
+	{
+		#ifdef HAVE_X86_SIMD
+		case LBM_SIMD_AVX2:
+			gbl_collision_kernel = lbm_simd_collision_avx2;
+			break;
+		case LBM_SIMD_AVX512:
+			gbl_collision_kernel = lbm_simd_collision_avx512;
+			break;
+		#endif
+		default:
+			gbl_collision_kernel = lbm_phys_cells_collision;
+			isa = LBM_SIMD_SCALAR;
+			break;
+	}
+	gbl_collision_isa = isa;
+
+	return isa;
+}
+
+/****************************************************/
+/**
+ * Same than lbm_simd_set() but the selected instruction set is reported on the master rank.
+ * @param isa The requested instruction set.
+ * @return The selected instruction set.
+**/
+lbm_simd_isa_t lbm_simd_select(lbm_simd_isa_t isa)
+{
+	//vars
+	int rank;
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+	//setup
+	isa = lbm_simd_set(isa);
+
+	//report
+	if (rank == 0)
+		printf("\033[32mSelect collision kernel %s (%d cells per instruction)\033[39m\n", lbm_config_simd_isa_name(isa), lbm_simd_cells_per_vector(isa));
+
+	return isa;
+}
+
+/****************************************************/
+/** Return the instruction set selected by lbm_simd_select(). **/
+lbm_simd_isa_t lbm_simd_selected(void)
+{
+	return gbl_collision_isa;
+}
+
+/****************************************************/
+/**
+ * Compute the collision of count consecutive cells with the selected kernel.
+ * @param cells_out Address of the first output cell.
+ * @param out_cell_stride Distance (in doubles) between two output cells.
+ * @param out_direction_stride Distance (in doubles) between two directions of an output cell.
+ * @param cells_in Address of the first input cell.
+ * @param in_cell_stride Distance (in doubles) between two input cells.
+ * @param in_direction_stride Distance (in doubles) between two directions of an input cell.
+ * @param count Number of cells to compute.
+**/
+void lbm_simd_collision_cells(double * cells_out, int out_cell_stride, int out_direction_stride,
+                              const double * cells_in, int in_cell_stride, int in_direction_stride,
+                              int count)
+{
+	gbl_collision_kernel(cells_out, out_cell_stride, out_direction_stride, cells_in, in_cell_stride, in_direction_stride, count);
+}
@@ -0,0 +1,36 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_SIMD_H
+#define LBM_SIMD_H
+
+/****************************************************/
+#include "lbm_config.h"
+
+/****************************************************/
+/**
+ * Prototype of the kernels computing the collision of count consecutive cells.
+ * The cells are separated by *_cell_stride doubles and the directions of a cell
+ * by *_direction_stride doubles, so the kernels work on every mesh layout.
+**/
+typedef void (*lbm_simd_collision_kernel_t)(double * cells_out, int out_cell_stride, int out_direction_stride,
+                                            const double * cells_in, int in_cell_stride, int in_direction_stride,
+                                            int count);
+
+/****************************************************/
+lbm_simd_isa_t lbm_simd_set(lbm_simd_isa_t isa);
+lbm_simd_isa_t lbm_simd_select(lbm_simd_isa_t isa);
+lbm_simd_isa_t lbm_simd_selected(void);
+int lbm_simd_supported(lbm_simd_isa_t isa);
+int lbm_simd_cells_per_vector(lbm_simd_isa_t isa);
+void lbm_simd_collision_cells(double * cells_out, int out_cell_stride, int out_direction_stride,
+                              const double * cells_in, int in_cell_stride, int in_direction_stride,
+                              int count);
+
+#endif //LBM_SIMD_H
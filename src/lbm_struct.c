@@ -8,24 +8,52 @@
 
 /****************************************************/
 #include <stdlib.h>
+#include <assert.h>
 #include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 #include "lbm_struct.h"
+#include "lbm_comm.h"
 
 /****************************************************/
 /**
- * Function used to initialize the local mesh.
+ * Function used to initialize the local mesh. The memory layout of the cells is
+ * taken from the config (MESH_LAYOUT).
  * @param mesh Mesh to init.
  * @param width With of the local mesh accounting the ghost cells.
  * @param height Height of the local mesh accounting the ghost cells.
 **/
 void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height )
 {
+	//vars
+	int i,j,k;
+
 	//setup params
 	mesh->width = width;
 	mesh->height = height;
+	mesh->layout = MESH_LAYOUT;
 
-	//alloc cells memory
-	mesh->cells = malloc( width * height  * DIRECTIONS * sizeof( double ) );
+	//setup layout
+	switch (mesh->layout)
+	{
+		case LBM_LAYOUT_AOS:
+			mesh->cell_stride = DIRECTIONS;
+			mesh->direction_stride = 1;
+			break;
+		case LBM_LAYOUT_SOA:
+			mesh->cell_stride = 1;
+			mesh->direction_stride = width * height;
+			break;
+	}
+
+	//alloc cells memory, with the shared exchange in a window the neighboors of the node
+	//can read. This is collective over the node, all the ranks allocate their meshes in the
+	//same order.
+	if (EXCHANGE_MODE == LBM_EXCHANGE_SHARED)
+		mesh->cells = lbm_comm_shared_alloc( width * height * DIRECTIONS * sizeof( double ) );
+	else
+		mesh->cells = malloc( width * height  * DIRECTIONS * sizeof( double ) );
 
 	//errors
 	if( mesh->cells == NULL )
@@ -33,6 +61,47 @@ void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height )
 		perror( "malloc" );
 		abort();
 	}
+
+	//ring around the mesh and its send buffer for the in place streaming
+	mesh->aa_swapped = 0;
+	mesh->aa_halo = NULL;
+	mesh->aa_buffer = NULL;
+	if (STEP_MODE == LBM_STEP_AA)
+	{
+		mesh->aa_halo = calloc( (2 * height + 2 * (width + 2)) * DIRECTIONS, sizeof( double ) );
+		mesh->aa_buffer = malloc( ((width + 2 > height) ? width + 2 : height) * DIRECTIONS * sizeof( double ) );
+		if( mesh->aa_halo == NULL || mesh->aa_buffer == NULL )
+		{
+			perror( "malloc" );
+			abort();
+		}
+	}
+
+	//column buffers of the threads, allocated once instead of at each step
+	mesh->columns = NULL;
+	mesh->column_threads = 0;
+	if (STEP_MODE == LBM_STEP_FUSED || STEP_MODE == LBM_STEP_AA)
+	{
+		#ifdef _OPENMP
+			mesh->column_threads = omp_get_max_threads();
+		#else
+			mesh->column_threads = 1;
+		#endif
+		mesh->columns = malloc( mesh->column_threads * 2 * DIRECTIONS * height * sizeof( double ) );
+		if( mesh->columns == NULL )
+		{
+			perror( "malloc" );
+			abort();
+		}
+	}
+
+	//first touch with the same distribution of the columns over the threads than
+	//the compute loops so the pages are placed on the NUMA node using them
+	#pragma omp parallel for private(j,k) schedule(static)
+	for ( i = 0 ; i < width ; i++ )
+		for ( j = 0 ; j < height ; j++ )
+			for ( k = 0 ; k < DIRECTIONS ; k++ )
+				*lbm_mesh_get_value(mesh, i, j, k) = 0.0;
 }
 
 /****************************************************/
@@ -43,9 +112,39 @@ void lbm_mesh_release( lbm_mesh_t * mesh )
 	mesh->width = 0;
 	mesh->height = 0;
 
-	//free memory
-	free( mesh->cells );
+	//free memory, the shared windows are freed collectively by the ranks of the node
+	if (mesh->cells != NULL && lbm_comm_shared_window( mesh->cells ) != MPI_WIN_NULL)
+		lbm_comm_shared_free( mesh->cells );
+	else
+		free( mesh->cells );
 	mesh->cells = NULL;
+	free( mesh->aa_halo );
+	mesh->aa_halo = NULL;
+	free( mesh->aa_buffer );
+	mesh->aa_buffer = NULL;
+	free( mesh->columns );
+	mesh->columns = NULL;
+	mesh->column_threads = 0;
+}
+
+/****************************************************/
+/**
+ * Exchange the content of two meshes of same size without copying the cells.
+ * Used by the step implementations which produce their result in the temporary mesh.
+**/
+void lbm_mesh_swap( lbm_mesh_t * mesh1, lbm_mesh_t * mesh2 )
+{
+	//vars
+	lbm_mesh_t tmp;
+
+	//errors
+	assert(mesh1->width == mesh2->width);
+	assert(mesh1->height == mesh2->height);
+
+	//swap
+	tmp = *mesh1;
+	*mesh1 = *mesh2;
+	*mesh2 = tmp;
 }
 
 /****************************************************/
@@ -57,6 +156,9 @@ void lbm_mesh_release( lbm_mesh_t * mesh )
 **/
 void lbm_mesh_type_t_init( lbm_mesh_type_t * meshtype, int width,  int height )
 {
+	//vars
+	int i,j;
+
 	//setup params
 	meshtype->width = width;
 	meshtype->height = height;
@@ -70,6 +172,12 @@ void lbm_mesh_type_t_init( lbm_mesh_type_t * meshtype, int width,  int height )
 		perror( "malloc" );
 		abort();
 	}
+
+	//first touch, same distribution than the compute loops
+	#pragma omp parallel for private(j) schedule(static)
+	for ( i = 0 ; i < width + 2 ; i++ )
+		for ( j = 0 ; j < height ; j++ )
+			*lbm_cell_type_t_get_cell(meshtype, i, j) = CELL_FUILD;
 }
 
 /****************************************************/
@@ -36,6 +36,35 @@ typedef struct lbm_mesh_s
 	int width;
 	/** Height of the local mesh (accounting the ghost cells). **/
 	int height;
+	/** Memory layout of the cells. **/
+	lbm_mesh_layout_t layout;
+	/** Distance (in doubles) between two consecutive cells. **/
+	int cell_stride;
+	/** Distance (in doubles) between two consecutive directions of a cell. **/
+	int direction_stride;
+	/**
+	 * With the in place AA streaming (LBM_STEP_AA), true after an even step : the
+	 * populations are stored swapped in the cell which computed them (see lbm_phys_aa_even_step()).
+	**/
+	int aa_swapped;
+	/**
+	 * With the in place AA streaming, ring of cells around the local mesh (contiguous
+	 * directions) storing the values which go out of the mesh or come from the neighboors.
+	 * NULL for the other step modes.
+	**/
+	double * aa_halo;
+	/**
+	 * With the in place AA streaming, send buffer of lbm_comm_aa_halo_exchange() able
+	 * to store a line of the ring. NULL for the other step modes.
+	**/
+	double * aa_buffer;
+	/**
+	 * With the column by column steps (LBM_STEP_FUSED and LBM_STEP_AA), one column before
+	 * and after collision for each OpenMP thread. NULL for the other step modes.
+	**/
+	double * columns;
+	/** Number of threads having a column buffer in columns. **/
+	int column_threads;
 } lbm_mesh_t;
 
 /****************************************************/
@@ -100,14 +129,21 @@ typedef struct lbm_data_file_s
 	FILE * fp;
 	/** Content of the headers. **/
 	lbm_file_header_t header;
-	/** Loaded data for the current frame. **/
+	/** Loaded data for the current frame, points into mapping if the file is mapped. **/
 	lbm_file_entry_t * entries;
+	/** Whole file mapped in memory, NULL if the frames are read with fread() into entries. **/
+	char * mapping;
+	/** Size of the file (and of mapping). **/
+	size_t size;
+	/** Position of the next frame in mapping. **/
+	size_t offset;
 } lbm_data_file_t;
 
 
 /****************************************************/
 void lbm_mesh_init( lbm_mesh_t * mesh, int width,  int height );
 void lbm_mesh_release( lbm_mesh_t * mesh );
+void lbm_mesh_swap( lbm_mesh_t * mesh1, lbm_mesh_t * mesh2 );
 
 /****************************************************/
 void lbm_mesh_type_t_init( lbm_mesh_type_t * mesh, int width,  int height );
@@ -120,13 +156,82 @@ void warning(const char * message);
 /****************************************************/
 /**
  * Function used to get the address of a given cell in the local mesh.
+ * This is the address of the first direction, the next ones are separated by
+ * mesh->direction_stride doubles (contiguous only with the LBM_LAYOUT_AOS layout).
  * @param mesh Pointer to the mesh struct.
  * @param x Position of the cell in the local mesh (accounting ghost cells)
  * @param y Position of the cell in the local mesh (accounting ghost cells)
 **/
 static inline double * lbm_mesh_get_cell( const lbm_mesh_t * mesh, int x, int y)
 {
-	return &mesh->cells[ (x * mesh->height + y) * DIRECTIONS ];
+	return &mesh->cells[ (x * mesh->height + y) * mesh->cell_stride ];
+}
+
+/****************************************************/
+/**
+ * Function used to get the address of one direction of a given cell in the local mesh.
+ * @param mesh Pointer to the mesh struct.
+ * @param x Position of the cell in the local mesh (accounting ghost cells)
+ * @param y Position of the cell in the local mesh (accounting ghost cells)
+ * @param k Direction to address.
+**/
+static inline double * lbm_mesh_get_value( const lbm_mesh_t * mesh, int x, int y, int k)
+{
+	return &lbm_mesh_get_cell(mesh, x, y)[ k * mesh->direction_stride ];
+}
+
+/****************************************************/
+/**
+ * Copy the DIRECTIONS values of a cell into a contiguous array whatever the mesh layout is.
+ * @param mesh Pointer to the mesh struct.
+ * @param x Position of the cell in the local mesh (accounting ghost cells)
+ * @param y Position of the cell in the local mesh (accounting ghost cells)
+ * @param cell Array of DIRECTIONS doubles to fill.
+**/
+static inline void lbm_mesh_load_cell( const lbm_mesh_t * mesh, int x, int y, lbm_mesh_cell_t cell)
+{
+	int k;
+	const double * src = lbm_mesh_get_cell(mesh, x, y);
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		cell[k] = src[ k * mesh->direction_stride ];
+}
+
+/****************************************************/
+/**
+ * Copy back the DIRECTIONS values of a cell from a contiguous array.
+ * @param mesh Pointer to the mesh struct.
+ * @param x Position of the cell in the local mesh (accounting ghost cells)
+ * @param y Position of the cell in the local mesh (accounting ghost cells)
+ * @param cell Array of DIRECTIONS doubles to copy.
+**/
+static inline void lbm_mesh_store_cell( const lbm_mesh_t * mesh, int x, int y, const lbm_mesh_cell_t cell)
+{
+	int k;
+	double * dest = lbm_mesh_get_cell(mesh, x, y);
+	for ( k = 0 ; k < DIRECTIONS ; k++ )
+		dest[ k * mesh->direction_stride ] = cell[k];
+}
+
+/****************************************************/
+/**
+ * Function used to get the address of a cell of the ring around the local mesh used by
+ * the in place AA streaming. The DIRECTIONS values of these cells are always contiguous.
+ * The left and right columns cover y in [0,height[, the top and bottom lines cover x in
+ * [-1,width] so they contain the corners.
+ * @param mesh Pointer to the mesh struct.
+ * @param x Position of the cell, in [-1,width].
+ * @param y Position of the cell, in [-1,height], (x,y) must be outside the local mesh.
+**/
+static inline double * lbm_mesh_get_halo_cell( const lbm_mesh_t * mesh, int x, int y)
+{
+	if (y < 0)
+		return &mesh->aa_halo[ (2 * mesh->height + x + 1) * DIRECTIONS ];
+	else if (y >= mesh->height)
+		return &mesh->aa_halo[ (2 * mesh->height + mesh->width + 2 + x + 1) * DIRECTIONS ];
+	else if (x < 0)
+		return &mesh->aa_halo[ y * DIRECTIONS ];
+	else
+		return &mesh->aa_halo[ (mesh->height + y) * DIRECTIONS ];
 }
 
 /****************************************************/
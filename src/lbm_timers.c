@@ -0,0 +1,155 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+#include "lbm_config.h"
+#include "lbm_struct.h"
+#include "lbm_comm.h"
+#include "lbm_simd.h"
+#include "lbm_timers.h"
+
+/****************************************************/
+double lbm_gbl_timers[LBM_TIMER_COUNT] = {0.0};
+
+/****************************************************/
+/** Name of a phase for the reports. **/
+const char * lbm_timer_phase_name(lbm_timer_phase_t phase)
+{
+	switch (phase)
+	{
+		case LBM_TIMER_SPECIAL_CELLS:
+			return "special_cells";
+		case LBM_TIMER_COLLISION:
+			return "collision";
+		case LBM_TIMER_EXCHANGE:
+			return "exchange";
+		case LBM_TIMER_PROPAGATION:
+			return "propagation";
+		case LBM_TIMER_COLLIDE_STREAM:
+			return "collide_stream";
+		case LBM_TIMER_SAVE:
+			return "save";
+		case LBM_TIMER_CHECKPOINT:
+			return "checkpoint";
+		case LBM_TIMER_COUNT:
+			break;
+	}
+	return "unknown";
+}
+
+/****************************************************/
+/**
+ * Memory traffic model of one lattice update used to compute the achieved bandwidth.
+ * Each pass over the mesh reads and writes the DIRECTIONS doubles of each cell, the
+ * write-allocate of the destination is not counted.
+**/
+static double lbm_timers_bytes_per_update(void)
+{
+	const double pass = 2.0 * DIRECTIONS * sizeof(double);
+	switch (STEP_MODE)
+	{
+		case LBM_STEP_CLASSIC:
+		case LBM_STEP_OVERLAP:
+			//collision then propagation
+			return 2.0 * pass;
+		case LBM_STEP_FUSED:
+		case LBM_STEP_AA:
+			return pass;
+	}
+	return pass;
+}
+
+/****************************************************/
+/**
+ * Reduce the phase timers over all the ranks and print the min/avg/max of each phase
+ * with the MLUPS (million lattice updates per second) and the achieved memory bandwidth.
+ * Must be called by all the ranks.
+ * @param steps Number of time steps done.
+ * @param total_time Duration of the time loop on the local rank.
+ * @param json_filename If not NULL, the master rank also writes the report in JSON in this file.
+**/
+void lbm_timers_report(int steps, double total_time, const char * json_filename)
+{
+	//vars
+	int rank, comm_size, threads = 1;
+	int p;
+	double min[LBM_TIMER_COUNT];
+	double max[LBM_TIMER_COUNT];
+	double sum[LBM_TIMER_COUNT];
+	double time;
+	FILE * fp;
+
+	//infos
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	#ifdef _OPENMP
+		threads = omp_get_max_threads();
+	#endif
+
+	//reduce
+	MPI_Reduce(lbm_gbl_timers, min, LBM_TIMER_COUNT, MPI_DOUBLE, MPI_MIN, RANK_MASTER, MPI_COMM_WORLD);
+	MPI_Reduce(lbm_gbl_timers, max, LBM_TIMER_COUNT, MPI_DOUBLE, MPI_MAX, RANK_MASTER, MPI_COMM_WORLD);
+	MPI_Reduce(lbm_gbl_timers, sum, LBM_TIMER_COUNT, MPI_DOUBLE, MPI_SUM, RANK_MASTER, MPI_COMM_WORLD);
+	MPI_Reduce(&total_time, &time, 1, MPI_DOUBLE, MPI_MAX, RANK_MASTER, MPI_COMM_WORLD);
+
+	//only master print
+	if (rank != RANK_MASTER)
+		return;
+
+	//global perf
+	double updates = (double)MESH_WIDTH * (double)MESH_HEIGHT * (double)steps;
+	double mlups = updates / time / 1e6;
+	double bandwidth = updates * lbm_timers_bytes_per_update() / time / 1e9;
+
+	//print
+	printf("=================== TIMERS ===================\n");
+	printf("%-16s %9s %9s %9s\n","phase (s)","min","avg","max");
+	for ( p = 0 ; p < LBM_TIMER_COUNT ; p++ )
+		printf("%-16s %9.3f %9.3f %9.3f\n", lbm_timer_phase_name(p), min[p], sum[p] / comm_size, max[p]);
+	printf("----------------------------------------------\n");
+	printf("%-20s = %g\n","total_time",time);
+	printf("%-20s = %g\n","mlups",mlups);
+	printf("%-20s = %g\n","bandwidth (GB/s)",bandwidth);
+	printf("==============================================\n");
+
+	//json
+	if (json_filename == NULL)
+		return;
+	fp = fopen(json_filename, "w");
+	if (fp == NULL)
+	{
+		perror(json_filename);
+		return;
+	}
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"ranks\": %d,\n", comm_size);
+	fprintf(fp, "\t\"threads\": %d,\n", threads);
+	fprintf(fp, "\t\"width\": %d,\n", MESH_WIDTH);
+	fprintf(fp, "\t\"height\": %d,\n", MESH_HEIGHT);
+	fprintf(fp, "\t\"steps\": %d,\n", steps);
+	fprintf(fp, "\t\"step_mode\": \"%s\",\n", lbm_config_step_mode_name(STEP_MODE));
+	fprintf(fp, "\t\"mesh_layout\": \"%s\",\n", lbm_config_mesh_layout_name(MESH_LAYOUT));
+	fprintf(fp, "\t\"simd\": \"%s\",\n", lbm_config_simd_isa_name(lbm_simd_selected()));
+	fprintf(fp, "\t\"total_time\": %.9g,\n", time);
+	fprintf(fp, "\t\"mlups\": %.9g,\n", mlups);
+	fprintf(fp, "\t\"bandwidth_gbs\": %.9g,\n", bandwidth);
+	fprintf(fp, "\t\"bytes_per_update\": %g,\n", lbm_timers_bytes_per_update());
+	fprintf(fp, "\t\"phases\": {\n");
+	for ( p = 0 ; p < LBM_TIMER_COUNT ; p++ )
+		fprintf(fp, "\t\t\"%s\": { \"min\": %.9g, \"avg\": %.9g, \"max\": %.9g }%s\n",
+			lbm_timer_phase_name(p), min[p], sum[p] / comm_size, max[p], (p < LBM_TIMER_COUNT - 1) ? "," : "");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+	fclose(fp);
+}
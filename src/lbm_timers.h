@@ -0,0 +1,67 @@
+/*****************************************************
+    AUTHOR  : Sébastien Valat
+    MAIL    : sebastien.valat@univ-grenoble-alpes.fr
+    LICENSE : BSD
+    YEAR    : 2021
+    COURSE  : Parallel Algorithms and Programming
+*****************************************************/
+
+/****************************************************/
+#ifndef LBM_TIMERS_H
+#define LBM_TIMERS_H
+
+/****************************************************/
+#include <mpi.h>
+#include "lbm_config.h"
+
+/****************************************************/
+/**
+ * Phases of a time step measured by the built-in profiler.
+**/
+typedef enum lbm_timer_phase_e
+{
+	/** Special actions on the border and obstacle cells. **/
+	LBM_TIMER_SPECIAL_CELLS,
+	/** Collision. **/
+	LBM_TIMER_COLLISION,
+	/** Ghost cells exchange, including the waiting time on the neighboors. **/
+	LBM_TIMER_EXCHANGE,
+	/** Propagation. **/
+	LBM_TIMER_PROPAGATION,
+	/** Single pass doing special actions, collision and propagation (fused and aa steps). **/
+	LBM_TIMER_COLLIDE_STREAM,
+	/** Fill and write of the output file. **/
+	LBM_TIMER_SAVE,
+	/** Write of the checkpoints. **/
+	LBM_TIMER_CHECKPOINT,
+	/** Number of phases. **/
+	LBM_TIMER_COUNT
+} lbm_timer_phase_t;
+
+/****************************************************/
+/** Time accumulated by each phase on the local rank. **/
+extern double lbm_gbl_timers[LBM_TIMER_COUNT];
+
+/****************************************************/
+/**
+ * Start measuring a phase, return the start date to give to lbm_timer_stop().
+**/
+static inline double lbm_timer_start(void)
+{
+	return MPI_Wtime();
+}
+
+/****************************************************/
+/**
+ * Accumulate the time elapsed since lbm_timer_start() into the given phase.
+**/
+static inline void lbm_timer_stop(lbm_timer_phase_t phase, double start)
+{
+	lbm_gbl_timers[phase] += MPI_Wtime() - start;
+}
+
+/****************************************************/
+const char * lbm_timer_phase_name(lbm_timer_phase_t phase);
+void lbm_timers_report(int steps, double total_time, const char * json_filename);
+
+#endif //LBM_TIMERS_H
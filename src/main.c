@@ -16,6 +16,9 @@
 /********************  HEADERS  *********************/
 #include <math.h>
 #include <mpi.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
 //if available use argp, if not fallback to getopt
 #ifdef HAVE_ARGP
 	#include <argp.h>
@@ -36,7 +39,11 @@
 #include "lbm_init.h"
 #include "lbm_comm.h"
 #include "lbm_save.h"
+#include "lbm_simd.h"
+#include "lbm_timers.h"
 #include "exercises.h"
+#include "lbm_balance.h"
+#include "lbm_checkpoint.h"
 
 /****************************************************/
 const char *argp_program_version = "lbm 1.0";
@@ -49,6 +56,15 @@ static char doc[] = "A simple simulation applying the Lattice Boltzmann Method (
 		{"exercise", 'e', "EXID",  0, "ID of the exercice to execute." },
 		{"no-out",   'n', 0,       0, "Skip output for benchmarking only compute and communications."},
 		{"scaling",  's', "FACTOR",0, "Apply weak scaling factor to increase the mesh size."},
+		{"step",     'm', "MODE",  0, "Step implementation to use: 'classic', 'fused', 'aa' or 'overlap' (override config file)."},
+		{"layout",   'l', "LAYOUT",0, "Memory layout of the mesh cells: 'aos' or 'soa' (override config file)."},
+		{"simd",     'i', "ISA",   0, "Collision kernel to use: 'scalar' (default, reference output), 'auto', 'avx2' or 'avx512' (override config file)."},
+		{"exchange", 'x', "MODE",  0, "Ghost cells exchange to use: 'exercise', 'persistent', 'directional', 'shared' or 'rma' (override config file)."},
+		{"halo",     'k', "DEPTH", 0, "Number of ghost layers exchanged every DEPTH steps, needs the persistent exchange (override config file)."},
+		{"threads",  't', "COUNT", 0, "Number of OpenMP threads per MPI rank (override config file)."},
+		{"balance",  'b', "MODE",  0, "Splitting of the mesh: 'even' or 'weighted' by the cost of the cells (override config file)."},
+		{"profile",  'j', "FILE",  0, "Write the timers report in JSON into FILE (override config file)."},
+		{"restart",  'r', "FILE",  0, "Resume the run from the checkpoint FILE, the number of ranks can differ."},
 		{ 0 }
 	};
 #else
@@ -57,15 +73,33 @@ static char doc[] = "A simple simulation applying the Lattice Boltzmann Method (
 			{ "exercise",   required_argument,      NULL,           'e' },
 			{ "scaling",    required_argument,      NULL,           's' },
 			{ "no-out",     no_argument,            NULL,           'n' },
+			{ "step",       required_argument,      NULL,           'm' },
+			{ "layout",     required_argument,      NULL,           'l' },
+			{ "simd",       required_argument,      NULL,           'i' },
+			{ "exchange",   required_argument,      NULL,           'x' },
+			{ "halo",       required_argument,      NULL,           'k' },
+			{ "threads",    required_argument,      NULL,           't' },
+			{ "balance",    required_argument,      NULL,           'b' },
+			{ "profile",    required_argument,      NULL,           'j' },
+			{ "restart",    required_argument,      NULL,           'r' },
 			{ "help",       no_argument,            NULL,           '?' },
 			{ NULL,         0,                      NULL,           0 }
 	};
-	static const char * short_options = "[-c CONFIG] [-e EXID] [-s SCALE] [-n]";
+	static const char * short_options = "[-c CONFIG] [-e EXID] [-s SCALE] [-n] [-m MODE] [-l LAYOUT] [-i ISA] [-x MODE] [-k DEPTH] [-t COUNT] [-b MODE] [-j FILE] [-r FILE]";
 	static const char * help_message = 
 		"-c/--config   {FILE}    Input config file to use.\n"
 		"-e/--exercise {EXID}    ID of the exercise to execute\n"
 		"-n/--no-out             Skip output for benchmarking only compute and communications.\n"
-		"-s/--scaling  {FACTOR}  Apply weak scaling factor to increase the mesh size.\n";
+		"-s/--scaling  {FACTOR}  Apply weak scaling factor to increase the mesh size.\n"
+		"-m/--step     {MODE}    Step implementation to use: 'classic', 'fused', 'aa' or 'overlap' (override config file).\n"
+		"-l/--layout   {LAYOUT}  Memory layout of the mesh cells: 'aos' or 'soa' (override config file).\n"
+		"-i/--simd     {ISA}     Collision kernel to use: 'scalar' (default, reference output), 'auto', 'avx2' or 'avx512' (override config file).\n"
+		"-x/--exchange {MODE}    Ghost cells exchange to use: 'exercise', 'persistent', 'directional', 'shared' or 'rma' (override config file).\n"
+		"-k/--halo     {DEPTH}   Number of ghost layers exchanged every DEPTH steps, needs the persistent exchange (override config file).\n"
+		"-t/--threads  {COUNT}   Number of OpenMP threads per MPI rank (override config file).\n"
+		"-b/--balance  {MODE}    Splitting of the mesh: 'even' or 'weighted' by the cost of the cells (override config file).\n"
+		"-j/--profile  {FILE}    Write the timers report in JSON into FILE (override config file).\n"
+		"-r/--restart  {FILE}    Resume the run from the checkpoint FILE, the number of ranks can differ.\n";
 #endif
 
 /****************************************************/
@@ -76,6 +110,15 @@ struct arguments
 	int exercice;
 	char * config_file;
 	int scaling;
+	const char * step_mode;
+	const char * mesh_layout;
+	const char * simd;
+	const char * exchange;
+	int halo_depth;
+	int threads;
+	const char * balance;
+	const char * profile;
+	const char * restart;
 };
 
 /****************************************************/
@@ -100,6 +143,33 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 		case 'n':
 			arguments->do_output = false;
 			break;
+		case 'm':
+			arguments->step_mode = arg;
+			break;
+		case 'l':
+			arguments->mesh_layout = arg;
+			break;
+		case 'i':
+			arguments->simd = arg;
+			break;
+		case 'x':
+			arguments->exchange = arg;
+			break;
+		case 'k':
+			arguments->halo_depth = atoi(arg);
+			break;
+		case 't':
+			arguments->threads = atoi(arg);
+			break;
+		case 'b':
+			arguments->balance = arg;
+			break;
+		case 'j':
+			arguments->profile = arg;
+			break;
+		case 'r':
+			arguments->restart = arg;
+			break;
 		case ARGP_KEY_ARG:
 			argp_usage (state);
 			break;
@@ -151,7 +221,7 @@ void print_help_message(char ** argv)
 void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 {
 	int c;
-	while ( (c = getopt_long(argc, argv, "c:e:s:nh", long_options, NULL)) != -1) {
+	while ( (c = getopt_long(argc, argv, "c:e:s:m:l:i:x:k:t:b:j:r:nh", long_options, NULL)) != -1) {
 		switch(c) {
 			case 'c':
 				arguments->config_file = strdup(optarg);
@@ -165,6 +235,33 @@ void parse_prgm_arguments(struct arguments * arguments, int argc, char ** argv)
 			case 'n':
 				arguments->do_output = false;
 				break;
+			case 'm':
+				arguments->step_mode = strdup(optarg);
+				break;
+			case 'l':
+				arguments->mesh_layout = strdup(optarg);
+				break;
+			case 'i':
+				arguments->simd = strdup(optarg);
+				break;
+			case 'x':
+				arguments->exchange = strdup(optarg);
+				break;
+			case 'k':
+				arguments->halo_depth = atoi(optarg);
+				break;
+			case 't':
+				arguments->threads = atoi(optarg);
+				break;
+			case 'b':
+				arguments->balance = strdup(optarg);
+				break;
+			case 'j':
+				arguments->profile = strdup(optarg);
+				break;
+			case 'r':
+				arguments->restart = strdup(optarg);
+				break;
 			case 'h':
 			case '?':
 				print_help_message(argv);
@@ -192,17 +289,22 @@ int main(int argc, char * argv[])
 {
 	//vars
 	lbm_mesh_t mesh;
-	lbm_mesh_t temp;
+	lbm_mesh_t temp = { .cells = NULL, .aa_halo = NULL };
 	lbm_mesh_type_t mesh_type;
 	lbm_comm_t comm;
 	lbm_file_mesh_t save_mesh;
-	int i, rank, comm_size;
+	int i, rank, comm_size, thread_level;
+	int first_iteration = 1;
+	bool checkpoint_pending = false;
 	const char * config_filename = NULL;
 
 	//init MPI and get current rank and commuincator size.
-	MPI_Init( &argc, &argv );
+	//the compute loops are threaded but only the master thread communicates.
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_level );
 	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
 	MPI_Comm_size( MPI_COMM_WORLD, &comm_size );
+	if (thread_level < MPI_THREAD_FUNNELED && rank == RANK_MASTER)
+		warning("MPI does not provide MPI_THREAD_FUNNELED, OpenMP threads may be unsafe !");
 
 	//parse args
 	struct arguments arguments = {
@@ -210,6 +312,15 @@ int main(int argc, char * argv[])
 		.exercice = 0,
 		.config_file = "config.txt",
 		.scaling = 1,
+		.step_mode = NULL,
+		.mesh_layout = NULL,
+		.simd = NULL,
+		.exchange = NULL,
+		.halo_depth = 0,
+		.threads = -1,
+		.balance = NULL,
+		.profile = NULL,
+		.restart = NULL,
 	};
 	parse_prgm_arguments(&arguments, argc, argv);
 
@@ -222,41 +333,61 @@ int main(int argc, char * argv[])
 	//apply option
 	if (arguments.do_output == false)
 		RESULT_FILENAME = NULL;
+	if (arguments.step_mode != NULL)
+		STEP_MODE = lbm_config_parse_step_mode(arguments.step_mode);
+	if (arguments.mesh_layout != NULL)
+		MESH_LAYOUT = lbm_config_parse_mesh_layout(arguments.mesh_layout);
+	if (arguments.simd != NULL)
+		SIMD_ISA = lbm_config_parse_simd_isa(arguments.simd);
+	if (arguments.exchange != NULL)
+		EXCHANGE_MODE = lbm_config_parse_exchange_mode(arguments.exchange);
+	if (arguments.halo_depth > 0)
+		HALO_DEPTH = arguments.halo_depth;
+	if (arguments.threads >= 0)
+		THREADS = arguments.threads;
+	if (arguments.balance != NULL)
+		BALANCE_MODE = lbm_config_parse_balance_mode(arguments.balance);
+	if (arguments.profile != NULL)
+		PROFILE_FILENAME = strdup(arguments.profile);
 
 	//apply scaling
-	if (arguments.scaling > 1) {
-		//apply
-		double factor = sqrt((double)arguments.scaling);
-		MESH_WIDTH = (double)MESH_WIDTH * factor;
-		MESH_HEIGHT = (double)MESH_HEIGHT * factor;
-
-		//make multiple of
-		if (MESH_WIDTH % comm_size != 0)
-			MESH_WIDTH += comm_size - MESH_WIDTH % comm_size;
-		if (MESH_HEIGHT % comm_size != 0)
-			MESH_HEIGHT -= MESH_HEIGHT % comm_size;
-
-		//recompute obstable
-		lbm_gbl_config.obstacle_r = (lbm_gbl_config.height / 10.0 + 1.0);
-		lbm_gbl_config.obstacle_y = (lbm_gbl_config.height / 2.0 + 3.0);
-	}
+	lbm_config_apply_scaling(arguments.scaling, comm_size);
 
 	//print config
 	if (rank == RANK_MASTER)
 		lbm_config_print();
+	if (rank == RANK_MASTER && EXCHANGE_MODE == LBM_EXCHANGE_DIRECTIONAL && (STEP_MODE == LBM_STEP_FUSED || STEP_MODE == LBM_STEP_AA))
+		warning("The fused and aa steps need all the populations of the ghost cells, the directional exchange sends full cells !");
+	if (HALO_DEPTH < 1)
+		fatal("halo_depth must be at least 1 !");
+	if (HALO_DEPTH > 1 && (EXCHANGE_MODE != LBM_EXCHANGE_PERSISTENT || (STEP_MODE != LBM_STEP_CLASSIC && STEP_MODE != LBM_STEP_FUSED) || REBALANCE_INTERVAL > 0))
+		fatal("halo_depth > 1 needs exchange = persistent, step_mode = classic or fused and no runtime rebalancing !");
 
 	//dispatch
 	lbm_ex_select(arguments.exercice);
+	lbm_simd_select(SIMD_ISA);
+
+	//setup threads
+	#ifdef _OPENMP
+		if (THREADS > 0)
+			omp_set_num_threads(THREADS);
+		if (rank == RANK_MASTER)
+			printf("\033[32mUse %d OpenMP threads per rank\033[39m\n", omp_get_max_threads());
+	#endif
 
 	//init structures, allocate memory...
 	lbm_comm_init_ex_select( &comm, MESH_WIDTH, MESH_HEIGHT);
+	if (rank == RANK_MASTER)
+		lbm_comm_print_grid( &comm, MESH_WIDTH, MESH_HEIGHT );
 	lbm_mesh_init( &mesh, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
-	lbm_mesh_init( &temp, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
+	//the in place streaming does not need the temporary mesh
+	if (STEP_MODE != LBM_STEP_AA)
+		lbm_mesh_init( &temp, lbm_comm_width( &comm ), lbm_comm_height( &comm ) );
 	lbm_mesh_type_t_init( &mesh_type, lbm_comm_width( &comm ), lbm_comm_height( &comm ));
 	lbm_save_mesh_init(&save_mesh, &comm);
 
-	//truncate file
-	if (RESULT_FILENAME != NULL) {
+	//truncate file, a restarted run keeps the frames before the checkpoint
+	if (RESULT_FILENAME != NULL && arguments.restart == NULL) {
 		if (rank == RANK_MASTER)
 			unlink(RESULT_FILENAME);
 		usleep(1000);
@@ -265,18 +396,24 @@ int main(int argc, char * argv[])
 
 	//master open the output file
 	// if( rank == RANK_MASTER )
-	lbm_open_output_file(&comm);
+	lbm_open_output_file(&comm, arguments.restart != NULL);
 	MPI_Barrier(MPI_COMM_WORLD);
 
 	//setup initial conditions on mesh
 	lbm_init_mesh_state( &mesh, &mesh_type, &comm);
-	lbm_init_mesh_state( &temp, &mesh_type, &comm);
+	if (STEP_MODE != LBM_STEP_AA)
+		lbm_init_mesh_state( &temp, &mesh_type, &comm);
 
 	// printf("//setup initial conditions on mesh\n");
 
-	//write initial condition in output file
-	if (lbm_gbl_config.output_filename != NULL)
+	//resume from the checkpoint or write initial condition in output file
+	if (arguments.restart != NULL) {
+		first_iteration = lbm_checkpoint_read(arguments.restart, &comm, &mesh, &temp) + 1;
+		if (rank == RANK_MASTER)
+			printf("Restart from iteration %d\n", first_iteration - 1);
+	} else if (lbm_gbl_config.output_filename != NULL) {
 		lbm_save_ex_select(&save_mesh, &comm, &mesh, &mesh_type, 0 / WRITE_STEP_INTERVAL);
+	}
 
 	//start time
 	struct timespec start;
@@ -287,16 +424,30 @@ int main(int argc, char * argv[])
 	clock_gettime(CLOCK_MONOTONIC, &full_start);
 
 	//time steps
-	for ( i = 1 ; i < ITERATIONS ; i++ )
+	for ( i = first_iteration ; i < ITERATIONS ; i++ )
 	{
 		//compute
 		// printf("Compute %d\n",i);
 		lbm_do_step_ex_select(&comm, &mesh_type, &mesh, &temp );
 
+		//move the cuts if the ranks are unbalanced
+		lbm_balance_runtime(&comm, &mesh, &temp, &mesh_type, &save_mesh, i);
+
 		//save step
 		if ( i % WRITE_STEP_INTERVAL == 0 && lbm_gbl_config.output_filename != NULL )
 			lbm_save_ex_select(&save_mesh, &comm, &mesh, &mesh_type, i / WRITE_STEP_INTERVAL);
-		
+
+		//checkpoint to restart the run, after an odd aa step a part of the state is in the
+		//aa halo of the mesh so it is delayed to the next step
+		if ( CHECKPOINT_INTERVAL > 0 && i % CHECKPOINT_INTERVAL == 0 && CHECKPOINT_FILENAME != NULL )
+			checkpoint_pending = true;
+		if ( checkpoint_pending && mesh.aa_swapped == 0 ) {
+			double timer = lbm_timer_start();
+			lbm_checkpoint_write(CHECKPOINT_FILENAME, &comm, &mesh, &temp, i);
+			lbm_timer_stop(LBM_TIMER_CHECKPOINT, timer);
+			checkpoint_pending = false;
+		}
+
 		//print progress
 		if( rank == RANK_MASTER && i % WRITE_STEP_INTERVAL == 0 ) {
 			//compute delta
@@ -319,7 +470,11 @@ int main(int argc, char * argv[])
 	if (rank == 0)
 		printf("Total time: %g seconds\n", full_time);
 
-	//close file
+	//per phase timers, MLUPS & bandwidth
+	lbm_timers_report(ITERATIONS - first_iteration, full_time, PROFILE_FILENAME);
+
+	//close file, after the end of the background writes
+	lbm_save_mesh_flush(&save_mesh);
 	if (RESULT_FILENAME != NULL)
 		MPI_File_close(&comm.file_handler);
 